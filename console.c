@@ -0,0 +1,173 @@
+/*
+ * console.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file console.c
+ *
+ * Module for parsing serial console lines, called by main Chico module
+ * The parser does not touch any hardware, so it can be fed from any source
+ ------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "include/console.h"
+
+/*!\brief Clear the console line.
+ *
+ *\details Empty the line buffer for the next line.
+ */
+void consoleClearLine(ConsoleLine *line) {
+	line->length = 0;
+	line->buffer[0] = '\0';
+}
+
+/*!\brief Add a received character to the console line.
+ *
+ *\details Backspace removes the last character, characters beyond the line size are dropped.
+ * Returns 1 when a carriage return or line feed ends a non-empty line, 0 otherwise.
+ */
+int consoleAddChar(ConsoleLine *line, char c) {
+	if (c == '\r' || c == '\n') {
+		return line->length > 0;
+	}
+	if (c == '\b' || c == 0x7F) {
+		if (line->length > 0) {
+			line->length--;
+			line->buffer[line->length] = '\0';
+		}
+		return 0;
+	}
+	if (line->length < CONSOLE_LINE_SIZE - 1) {
+		line->buffer[line->length] = c;
+		line->length++;
+		line->buffer[line->length] = '\0';
+	}
+	return 0;
+}
+
+/*!\brief Parse a console line.
+ *
+ *\details Accepted lines, case insensitive:
+ * - S, A: stop, attachment mode
+ * - F, B [cm]: move forward or backward, optionally for a distance in cm
+ * - L, R [degrees]: spin left or right, optionally for an angle in degrees
+ * - T, D, V, W: query temperatures, sonar distance, speed and distance, WiFi statistics
+ * - Z: query a binary telemetry frame, for machine consumers
+ * - C: query CPU time of tasks, interrupts and busy-waits
+ * - O: query the nearest obstacle and free direction of the range map
+ * - P: query the hottest direction of the thermal panorama
+ * - M script: run a motion script, refer motionScript.h; the script is not checked here
+ * - H or ?: help
+ * Distances and angles are converted to behavior cycles, rounded up; a move without argument
+ * has cycles 0, meaning the same duration as the web page command.
+ * Returns the command type, CONSOLE_INVALID if the line is not accepted.
+ */
+int consoleParseLine(const char *line, ConsoleCommand *command) {
+	char *end;
+	long argument = 0;
+	int perCycle = 0;
+
+	command->type = CONSOLE_INVALID;
+	command->move = '\0';
+	command->cycles = 0;
+	command->script = NULL;
+
+	while (*line == ' ') {
+		line++;
+	}
+	char c = toupper((unsigned char) *line);
+	if (c == '\0') {
+		return CONSOLE_INVALID;
+	}
+	line++;
+
+	// optional argument, separated by spaces
+	while (*line == ' ') {
+		line++;
+	}
+	// the argument of a script is the rest of the line
+	if (c == 'M') {
+		if (*line == '\0') {
+			return CONSOLE_INVALID;
+		}
+		command->type = CONSOLE_SCRIPT;
+		command->script = line;
+		return command->type;
+	}
+	if (*line != '\0') {
+		argument = strtol(line, &end, 10);
+		while (*end == ' ') {
+			end++;
+		}
+		if (end == line || *end != '\0' || argument <= 0 || argument > CONSOLE_MAX_ARGUMENT) {
+			return CONSOLE_INVALID;
+		}
+	}
+
+	switch (c) {
+	case 'F':
+	case 'B':
+		perCycle = CONSOLE_CM_PER_CYCLE;
+		break;
+	case 'L':
+	case 'R':
+		perCycle = CONSOLE_DEGREES_PER_CYCLE;
+		break;
+	case 'S':
+	case 'A':
+		break;
+	case 'T':
+		command->type = CONSOLE_QUERY_TEMPERATURE;
+		break;
+	case 'D':
+		command->type = CONSOLE_QUERY_SONAR;
+		break;
+	case 'V':
+		command->type = CONSOLE_QUERY_SPEED;
+		break;
+	case 'W':
+		command->type = CONSOLE_QUERY_STATISTICS;
+		break;
+	case 'Z':
+		command->type = CONSOLE_QUERY_TELEMETRY;
+		break;
+	case 'C':
+		command->type = CONSOLE_QUERY_CPU;
+		break;
+	case 'O':
+		command->type = CONSOLE_QUERY_OBSTACLE;
+		break;
+	case 'P':
+		command->type = CONSOLE_QUERY_PANORAMA;
+		break;
+	case 'H':
+	case '?':
+		command->type = CONSOLE_HELP;
+		break;
+	default:
+		return CONSOLE_INVALID;
+	}
+
+	if (command->type != CONSOLE_INVALID) {
+		// queries take no argument
+		if (argument != 0) {
+			command->type = CONSOLE_INVALID;
+		}
+		return command->type;
+	}
+
+	// only distance and angle moves take an argument
+	if (argument != 0) {
+		if (perCycle == 0) {
+			return CONSOLE_INVALID;
+		}
+		command->cycles = (argument + perCycle - 1) / perCycle;
+	}
+	command->type = CONSOLE_MOVE;
+	command->move = c;
+	return command->type;
+}
@@ -0,0 +1,215 @@
+/*
+ * cpuStats.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file cpuStats.c
+ *
+ * Module for CPU time accounting, called by main Chico module
+ * Task run time is counted by FreeRTOS on the custom timer clock, interrupt and busy-wait time by this module;
+ * each is reported in permille of a window, between two updates
+ ------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "include/cpuStats.h"
+#include "include/custom_timer.h"
+
+// name of the FreeRTOS idle task
+#define CPU_STATS_IDLE_NAME "IDLE"
+
+volatile uint32_t cpuStatsIsrCounts[CPU_STATS_ISR_SOURCES];
+// time spent in busy-waits, in microseconds
+uint32_t cpuStatsBusyWaitTime = 0;
+
+// counters at the start of the window
+uint32_t windowStart = 0;
+uint32_t windowIsrCounts[CPU_STATS_ISR_SOURCES];
+uint32_t windowBusyWaitTime = 0;
+UBaseType_t windowTaskNumbers[CPU_STATS_TASKS];
+uint32_t windowTaskRunTimes[CPU_STATS_TASKS];
+int windowTasks = 0;
+
+// results of the last window
+uint32_t statsWindow = 0;
+int statsTasks = 0;
+int statsTotalTasks = 0;
+char statsTaskNames[CPU_STATS_TASKS][CPU_STATS_NAME_SIZE];
+uint16_t statsTaskPermille[CPU_STATS_TASKS];
+// least stack left of each task since it started, in bytes
+uint16_t statsTaskStackFree[CPU_STATS_TASKS];
+uint16_t statsIdle = 0;
+uint16_t statsIsr[CPU_STATS_ISR_SOURCES];
+uint16_t statsBusyWait = 0;
+
+#if configUSE_TRACE_FACILITY == 1 && configGENERATE_RUN_TIME_STATS == 1
+	// too large for the stack of the calling task
+	TaskStatus_t taskStatus[CPU_STATS_TASKS];
+#endif
+
+/*!\brief Permille of the window.
+ *
+ *\details Time in microseconds as permille of a window, rounded down.
+ */
+uint16_t permilleOfWindow(uint32_t time, uint32_t window) {
+	uint32_t permilleTime = window / 1000;
+
+	if (permilleTime == 0) {
+		return 0;
+	}
+	time /= permilleTime;
+	return (time > 1000) ? 1000 : (uint16_t) time;
+}
+
+/*!\brief Add busy-wait time.
+ *
+ *\details Called after a task spins on the CPU, example the remainder of delay_milliseconds().
+ */
+void addCpuStatsBusyWait(uint32_t microseconds) {
+	taskENTER_CRITICAL();
+	cpuStatsBusyWaitTime += microseconds;
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief Update CPU statistics.
+ *
+ *\details Ends the window, computes the share of each task, interrupt and busy-wait over the window, and starts
+ * the next window. Called periodically by one task; the first window starts at power-on.
+ * Interrupt and busy-wait time is also counted in the run time of the task they happen in.
+ */
+void updateCpuStats(void) {
+	uint32_t now = time_in_microseconds();
+	uint32_t window = now - windowStart;
+	uint32_t isrCounts[CPU_STATS_ISR_SOURCES];
+	uint32_t busyWaitTime;
+	uint32_t runTime;
+	int tasks = 0;
+	int totalTasks = 0;
+
+	taskENTER_CRITICAL();
+	for (int i = 0; i < CPU_STATS_ISR_SOURCES; i++) {
+		isrCounts[i] = cpuStatsIsrCounts[i];
+	}
+	busyWaitTime = cpuStatsBusyWaitTime;
+	taskEXIT_CRITICAL();
+
+	#if configUSE_TRACE_FACILITY == 1 && configGENERATE_RUN_TIME_STATS == 1
+		// the state of all tasks is returned, or none if they do not fit
+		totalTasks = uxTaskGetNumberOfTasks();
+		if (totalTasks <= CPU_STATS_TASKS) {
+			tasks = uxTaskGetSystemState(taskStatus, CPU_STATS_TASKS, NULL);
+		}
+	#endif
+
+	// results are read by other tasks, the scheduler is suspended rather than interrupts disabled for the divisions
+	vTaskSuspendAll();
+	statsWindow = window;
+	for (int i = 0; i < CPU_STATS_ISR_SOURCES; i++) {
+		statsIsr[i] = permilleOfWindow((isrCounts[i] - windowIsrCounts[i]) * CPU_STATS_MICROSECONDS_PER_COUNT, window);
+		windowIsrCounts[i] = isrCounts[i];
+	}
+	statsBusyWait = permilleOfWindow(busyWaitTime - windowBusyWaitTime, window);
+	windowBusyWaitTime = busyWaitTime;
+
+	#if configUSE_TRACE_FACILITY == 1 && configGENERATE_RUN_TIME_STATS == 1
+		statsIdle = 0;
+		for (int i = 0; i < tasks; i++) {
+			// a task created in the window has run only in the window
+			runTime = taskStatus[i].ulRunTimeCounter;
+			for (int j = 0; j < windowTasks; j++) {
+				if (windowTaskNumbers[j] == taskStatus[i].xTaskNumber) {
+					runTime -= windowTaskRunTimes[j];
+					break;
+				}
+			}
+			strncpy(statsTaskNames[i], taskStatus[i].pcTaskName, CPU_STATS_NAME_SIZE - 1);
+			statsTaskNames[i][CPU_STATS_NAME_SIZE - 1] = '\0';
+			statsTaskPermille[i] = permilleOfWindow(runTime, window);
+			statsTaskStackFree[i] = taskStatus[i].usStackHighWaterMark;
+			if (strcmp(statsTaskNames[i], CPU_STATS_IDLE_NAME) == 0) {
+				statsIdle = statsTaskPermille[i];
+			}
+		}
+		for (int i = 0; i < tasks; i++) {
+			windowTaskNumbers[i] = taskStatus[i].xTaskNumber;
+			windowTaskRunTimes[i] = taskStatus[i].ulRunTimeCounter;
+		}
+	#endif
+	statsTasks = tasks;
+	statsTotalTasks = totalTasks;
+	windowTasks = tasks;
+	windowStart = now;
+	xTaskResumeAll();
+}
+
+/*!\brief Get the length of the last window.
+ *
+ *\details Returns the window in microseconds, 0 before the first update.
+ */
+uint32_t getCpuStatsWindow(void) {
+	uint32_t window;
+
+	taskENTER_CRITICAL();
+	window = statsWindow;
+	taskEXIT_CRITICAL();
+	return window;
+}
+
+/*!\brief Get the number of tasks reported.
+ *
+ *\details Tasks of the last window, 0 before the first update or without run-time stats; also 0 when there are
+ * more than CPU_STATS_TASKS tasks, total is then larger than the tasks reported.
+ */
+int getCpuStatsTasks(int *total) {
+	int tasks;
+
+	taskENTER_CRITICAL();
+	tasks = statsTasks;
+	*total = statsTotalTasks;
+	taskEXIT_CRITICAL();
+	return tasks;
+}
+
+/*!\brief Get the CPU share of a task.
+ *
+ *\details Copies the task name, CPU_STATS_NAME_SIZE characters at most, and the least stack the task had left
+ * since it started, its high water mark in bytes; returns permille of the last window.
+ */
+uint16_t getCpuStatsTask(int index, char *name, uint16_t *stackFree) {
+	uint16_t permille;
+
+	taskENTER_CRITICAL();
+	strcpy(name, statsTaskNames[index]);
+	permille = statsTaskPermille[index];
+	*stackFree = statsTaskStackFree[index];
+	taskEXIT_CRITICAL();
+	return permille;
+}
+
+/*!\brief Get the idle share.
+ *
+ *\details Run time of the idle task, permille of the last window.
+ */
+uint16_t getCpuStatsIdle(void) {
+	return statsIdle;
+}
+
+/*!\brief Get the CPU share of an interrupt.
+ *
+ *\details Refer CPU_STATS_ISR_ sources, permille of the last window.
+ */
+uint16_t getCpuStatsIsr(int source) {
+	return statsIsr[source];
+}
+
+/*!\brief Get the busy-wait share.
+ *
+ *\details Busy-wait time, permille of the last window.
+ */
+uint16_t getCpuStatsBusyWait(void) {
+	return statsBusyWait;
+}
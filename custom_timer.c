@@ -24,24 +24,37 @@
  * 	\brief This file defines and implements the custom timer functions including APIs.
  *
  * \details Defines functions such as providing tick time in microseconds, milliseconds, delay in milliseconds. This
- * module uses TIMER0 of ATMega2560 with a pre-scale of 64, and fast PWM mode.
+ * module uses TIMER0 of ATMega2560 with a pre-scale of 64, and normal mode. It also provides one-shot and periodic
+ * callbacks, on a timer wheel driven by TIMER0.
  *
  * ATMega2560 TC (Timer/Counter) is like a clock, and can be used to measure time events. All the timers depends on
  * the system clock of system, the system clock is 16MHz for ATMega2560. Timer0: Timer0 is a 8bit timer, and is capable
  * of counting 2^8 = 256 steps from 0 to 255 (TOP). It can operate in normal mode, CTC mode or PWM mode. TIMER0 is
  * configured with pre-scaler 64 at 250 KHz with a resolution of 4μs.
  *
- * Fast PWM Mode: The fast Pulse Width Modulation or fast PWM mode provides a high frequency PWM wave-form generation
- * option. The fast PWM differs from the other PWM option by its single-slope operation. The counter counts from BOTTOM
- * to TOP then restarts from BOTTOM. In fast PWM mode, the counter is incremented until the counter value matches the TOP
- * value. The counter is then cleared at the following timer clock cycle.
+ * Normal Mode: The counter counts from BOTTOM to MAX (255) then restarts from BOTTOM, setting the overflow flag; same
+ * overflow rate as fast PWM mode. Unlike fast PWM mode, compare register OCR0A is not double buffered, so a compare
+ * match can be set within the current count.
+ *
+ * Timer Wheel: callbacks are kept in 32 slots, a slot for each TIMER0 overflow (1024μs); a callback farther than 32
+ * overflows waits for rounds of the wheel. The overflow ISR moves callbacks due in this overflow to a compare list,
+ * sorted by count, and OCR0A compare match fires them at their count. Insert and expiry are O(1) on the wheel, the
+ * compare list holds only callbacks of the current overflow. Resolution is a count of TIMER0 i.e. 4μs.
  *
  * Module APIs:
- * 	- initialize_module_timer0(): initializes TIMER0 in fast PWM mode with pre-scale of 64, and activates it. Ensure this
+ * 	- initialize_module_timer0(): initializes TIMER0 in normal mode with pre-scale of 64, and activates it. Ensure this
  * 		is called at the beginning of program.
- * 	- time_in_microseconds(): returns time in microseconds.
+ * 	- time_in_microseconds(): returns time in microseconds, wraps after approximately 71 minutes.
+ * 	- time_in_microseconds_64(): returns time in microseconds, 64 bits; does not wrap.
  * 	- time_in_milliseconds(): returns time in milliseconds.
- * 	- delay_milliseconds(): accepts milliseconds and introduces required delay.
+ * 	- delay_milliseconds(): accepts milliseconds and introduces required delay; in a task, sleeps for whole ticks and
+ * 		spins only for the remainder.
+ * 	- time_microseconds_to_ticks(), time_ticks_to_microseconds(): convert durations to and from FreeRTOS ticks.
+ * 	- time_at_tick(), time_tick_at(): convert between FreeRTOS tick count and time in microseconds.
+ * 	- time_deadline_after(), time_deadline_expired(), time_until_deadline(): deadlines, in 64 bit microseconds.
+ * 	- time_interval_start(), time_interval_due(): periodic intervals, without drift.
+ * 	- timer_callback_start(), timer_callback_stop(): one-shot and periodic callbacks, in microseconds.
+ * 	- timer_callback_start_worker(): starts the worker task of deferred callbacks.
  *
  *
  * \note Ensure to initialize the module in the beginning of program.
@@ -57,8 +70,24 @@
  * 			Example: To capture time elapsed between two events, capture time ticks using time_in_microseconds() or
  * 			time_in_milliseconds(); and the difference between two values will provide the required time elapsed value.
  *
- * 		=> Use delay_milliseconds to introduce a delay in milliseconds. Note that this function does not releases
- * 			CPU/microprocessor.
+ * 		=> Use time_in_microseconds_64() to timestamp events, all modules share the same clock for as long as the
+ * 			robot runs. Use time_at_tick() to timestamp events of a task, given by xTaskGetTickCount(), on the same clock.
+ *
+ * 			Example: Wait for a deadline in a task, releasing CPU:
+ * 				deadline = time_deadline_after(20000);
+ * 				vTaskDelay(time_microseconds_to_ticks(time_until_deadline(deadline)));
+ *
+ * 		=> Use delay_milliseconds to introduce a delay in milliseconds. In a task, it releases CPU/microprocessor for
+ * 			whole ticks of the delay, and spins for the remainder shorter than a tick. In an ISR, with interrupts
+ * 			disabled, or before the scheduler is started, it spins for the whole delay.
+ *
+ * 		=> Use timer_callback_start() for a callback at a precise time, or periodic without drift. A callback in ISR
+ * 			context must be short, and may only call ISR safe functions (FromISR in FreeRTOS); a deferred callback is
+ * 			called by the worker task, started once with timer_callback_start_worker().
+ *
+ * 			Example: Toggle a pin every 5ms:
+ * 				static TIMER_CALLBACK toggle_timer;
+ * 				timer_callback_start(&toggle_timer, 5000, 5000, toggle_pin, NULL, TIMER_CALLBACK_IN_ISR);
  *
  *
  *
@@ -77,9 +106,16 @@
 /*AVR library*/
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/delay.h>
+
+/*FreeRTOS, for ticks, and worker task of deferred callbacks*/
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
 
 /* module includes */
 #include "include/custom_timer.h"		/* for module functions */
+#include "include/cpuStats.h"			/* for ISR and busy-wait time accounting */
 
 
 /******************************************************************************************************************/
@@ -105,6 +141,16 @@
 #define TIME_IN_MILLISSECONDS_FOR_TIMER0_OVERFLOW_FRACTION 				( (TIME_IN_MICROSECONDS_FOR_TIMER0_OVERFLOW % 1000) >> 3 )		/*!<Milliseconds per TIMER0 overflow - Fractional Portion.*/
 /* Milliseconds per TIMER0 overflow - Maximum Fractional Portion i.e. 1000*/
 #define TIME_IN_MILLISSECONDS_FOR_TIMER0_OVERFLOW_FRACTION_MAXIMUM 		( 1000 >> 3)													/*!<Milliseconds per TIMER0 overflow - Maximum Fractional Portion i.e. 1000*/
+/* FreeRTOS tick period in microseconds*/
+#define TIME_IN_MICROSECONDS_FOR_TICK									( 1000000UL / configTICK_RATE_HZ )								/*!<FreeRTOS tick period in micro-seconds.*/
+/* TIMER0 count period in microseconds*/
+#define TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT							( 64 / CPU_CYCLES_IN_ONE_MICROSECOND() )						/*!<TIMER0 count period in micro-seconds i.e. resolution of callbacks.*/
+#define TIMER_WHEEL_SLOT_MASK											( TIMER_WHEEL_SLOTS - 1 )										/*!<Mask of overflow counter for the wheel slot.*/
+
+/* Timer callback state*/
+#define TIMER_CALLBACK_INACTIVE											0																/*!<Callback is not on the wheel*/
+#define TIMER_CALLBACK_ON_WHEEL											1																/*!<Callback is in a wheel slot*/
+#define TIMER_CALLBACK_IN_COMPARE_LIST									2																/*!<Callback is due in current overflow, in compare list*/
 
 
 /******************************************************************************************************************/
@@ -131,13 +177,17 @@
  *
  */
 struct timer_counter_parameters{
-	volatile unsigned long timer0_overflow_counter;										/*!<Overflow counter*/
+	volatile uint64_t timer0_overflow_counter;											/*!<Overflow counter, 64 bits so time in microseconds does not wrap*/
 	volatile unsigned long timer0_time_in_milliseconds;									/*!<Milliseconds - integral portion*/
 	volatile unsigned char timer0_time_fraction;										/*!<Milliseconds - fraction portion*/
 };
 
 static struct timer_counter_parameters timer_counter_timer0;							/*!<Varaible holding TIMER0 values*/
 
+static TIMER_CALLBACK *timer_wheel[TIMER_WHEEL_SLOTS];									/*!<Timer wheel, a list of callbacks for each slot*/
+static TIMER_CALLBACK *timer_compare_list;												/*!<Callbacks due in current overflow, sorted by count*/
+static QueueHandle_t timer_worker_queue;												/*!<Deferred callbacks, read by worker task*/
+
 
 /******************************************************************************************************************/
 /* CODING STANDARDS
@@ -164,9 +214,33 @@ static struct timer_counter_parameters timer_counter_timer0;							/*!<Varaible
  * defining them later.
  */
 
+/*Insert a callback on the wheel, or in compare list if due in current overflow*/
+void timer_wheel_insert(TIMER_CALLBACK *timer);
+
+/*Remove a callback from the wheel or compare list*/
+void timer_wheel_remove(TIMER_CALLBACK *timer);
+
+/*Move the callbacks due in current overflow to compare list*/
+void timer_wheel_advance(void);
+
+/*Insert a callback in compare list, sorted by count*/
+void timer_compare_insert(TIMER_CALLBACK *timer);
+
+/*Fire due callbacks of compare list, and set compare match for the next one*/
+void timer_compare_dispatch(void);
+
+/*Fire a callback*/
+void timer_callback_fire(TIMER_CALLBACK *timer);
+
+/*Worker task of deferred callbacks*/
+void timer_callback_worker(void *parameters);
+
 /*Interrupt service routine for TIMER0 overflow*/
 ISR(TIMER0_OVF_vect);
 
+/*Interrupt service routine for TIMER0 compare match A*/
+ISR(TIMER0_COMPA_vect);
+
 /*---------------------------------------  ENTRY POINTS  ---------------------------------------------------------*/
 /*define your entry points here*/
 
@@ -189,9 +263,10 @@ void initialize_module_timer0(void){
 
 	sei();
 
-	/*TIMER0 - Fast PWM Mode*/
-	SET_BIT(TCCR0A, WGM01);
-	SET_BIT(TCCR0A, WGM00);
+	/*TIMER0 - Normal Mode, so OCR0A is updated at once for callbacks*/
+	CLEAR_BIT(TCCR0A, WGM01);
+	CLEAR_BIT(TCCR0A, WGM00);
+	CLEAR_BIT(TCCR0B, WGM02);
 
 	/*TIMER0 - pre-scale factor to 64*/
 	SET_BIT(TCCR0B, CS01);
@@ -210,28 +285,42 @@ void initialize_module_timer0(void){
 
 /*!\brief Time ticks in microseconds.
  *
- * \details Returns time in microseconds, using TIMER0.
+ * \details Returns time in microseconds, using TIMER0; lower 32 bits of time_in_microseconds_64().
  *
+ * \note Wraps after approximately 71 minutes; difference of two values is valid for intervals shorter than that.
  *
  *
- * @return void
+ * @return time in microseconds
  *
  */
 unsigned long time_in_microseconds(void){
-	unsigned long microseconds = 0;
+	return (unsigned long) time_in_microseconds_64();
+}
+
+
+/*!\brief Time ticks in microseconds, 64 bits.
+ *
+ * \details Returns time in microseconds, using TIMER0. Monotonic, and does not wrap in the life of the robot.
+ *
+ *
+ *
+ * @return time in microseconds
+ *
+ */
+uint64_t time_in_microseconds_64(void){
+	uint64_t overflow_count = 0;
 	uint8_t backup_SREG = SREG, timer_counter = 0;
 
 	cli();
-	microseconds  = timer_counter_timer0.timer0_overflow_counter;
+	overflow_count = timer_counter_timer0.timer0_overflow_counter;
 	timer_counter = TCNT0;
 
 	if ((TIFR0 & _BV(TOV0)) && (timer_counter < 255))
-		microseconds ++;
+		overflow_count++;
 
 	SREG = backup_SREG;
 
-	return ((microseconds  << 8) + timer_counter) * (64 / CPU_CYCLES_IN_ONE_MICROSECOND());
-
+	return ((overflow_count << 8) + timer_counter) * TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT;
 }
 
 
@@ -258,24 +347,305 @@ unsigned long time_in_milliseconds(void){
 
 /*!\brief Time delay in milliseconds.
  *
- * \details delay time in milliseconds, using TIMER0.
+ * \details delay time in milliseconds, using TIMER0. Called from a task, sleeps with vTaskDelay() for whole ticks
+ * of the delay, so other tasks can run, then spins until the end of delay, which is less than a tick. Delay is never
+ * shorter than requested. Time spun is counted as busy-wait CPU time, refer cpuStats.h.
  *
- * \note It does not releases CPU/microprocessor.
+ * \note In an ISR, with interrupts disabled, or before the scheduler is started, it does not release
+ * CPU/microprocessor; with interrupts disabled, TIMER0 does not advance time, hence it spins on CPU cycles instead.
+ * \note Scheduler state is known only with INCLUDE_xTaskGetSchedulerState set to 1 in FreeRTOSConfig.h; otherwise it
+ * always spins.
  *
  *
  * @return void
  *
  */
 void delay_milliseconds(unsigned long milliseconds){
-    uint16_t start_time = (uint16_t)time_in_microseconds();
+	uint64_t deadline = 0;
+	uint64_t remaining_time = 0;
+	uint64_t spin_start = 0;
+
+	if (!(SREG & _BV(SREG_I))){
+		/*ISR or interrupts disabled*/
+		addCpuStatsBusyWait(milliseconds * 1000);
+		while (milliseconds > 0){
+			_delay_ms(1);
+			milliseconds--;
+		}
+		return;
+	}
+
+	deadline = time_deadline_after((uint64_t) milliseconds * 1000);
+
+	#if INCLUDE_xTaskGetSchedulerState == 1
+		if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING){
+			/*vTaskDelay(n) sleeps at most n ticks, so it never passes the deadline*/
+			remaining_time = time_until_deadline(deadline);
+			while (remaining_time >= TIME_IN_MICROSECONDS_FOR_TICK){
+				vTaskDelay((TickType_t) (remaining_time / TIME_IN_MICROSECONDS_FOR_TICK));
+				remaining_time = time_until_deadline(deadline);
+			}
+		}
+	#endif
+
+	/*Remainder, shorter than a tick*/
+	spin_start = time_in_microseconds_64();
+	while (time_deadline_expired(deadline) == 0){
+	}
+	addCpuStatsBusyWait((uint32_t) (time_in_microseconds_64() - spin_start));
+}
 
-    while (milliseconds > 0) {
-        if (((uint16_t)time_in_microseconds() - start_time) >= 1000) {
-        	milliseconds--;
-        	start_time += 1000;
-        }
-    }
 
+/*!\brief Convert microseconds to FreeRTOS ticks.
+ *
+ * \details Converts a duration, rounded up to whole ticks so a delay is never shorter than requested.
+ *
+ *
+ * @param microseconds - duration in microseconds.
+ * @return duration in ticks
+ *
+ */
+TickType_t time_microseconds_to_ticks(uint64_t microseconds){
+	return (TickType_t) ((microseconds + TIME_IN_MICROSECONDS_FOR_TICK - 1) / TIME_IN_MICROSECONDS_FOR_TICK);
+}
+
+
+/*!\brief Convert FreeRTOS ticks to microseconds.
+ *
+ * \details Converts a duration.
+ *
+ *
+ * @param ticks - duration in ticks.
+ * @return duration in microseconds
+ *
+ */
+uint64_t time_ticks_to_microseconds(TickType_t ticks){
+	return (uint64_t) ticks * TIME_IN_MICROSECONDS_FOR_TICK;
+}
+
+
+/*!\brief Time of a FreeRTOS tick count.
+ *
+ * \details Returns time in microseconds, as of time_in_microseconds_64(), of a tick count in the past, example a
+ * tick count given by xTaskGetTickCount(). Accurate to a tick.
+ *
+ * \note Tick count must be within half the tick counter range of current tick count.
+ *
+ *
+ * @param tick - tick count.
+ * @return time in microseconds
+ *
+ */
+uint64_t time_at_tick(TickType_t tick){
+	TickType_t ticks_elapsed = xTaskGetTickCount() - tick;
+
+	return time_in_microseconds_64() - time_ticks_to_microseconds(ticks_elapsed);
+}
+
+
+/*!\brief FreeRTOS tick count of a time.
+ *
+ * \details Returns tick count, as of xTaskGetTickCount(), at a time in microseconds in the future, rounded up to
+ * whole ticks; current tick count if time is not in the future.
+ *
+ *
+ * @param time - time in microseconds, as of time_in_microseconds_64().
+ * @return tick count
+ *
+ */
+TickType_t time_tick_at(uint64_t time){
+	return xTaskGetTickCount() + time_microseconds_to_ticks(time_until_deadline(time));
+}
+
+
+/*!\brief Deadline after a duration.
+ *
+ * \details Returns the time a duration after current time, to check with time_deadline_expired().
+ *
+ *
+ * @param microseconds - duration in microseconds.
+ * @return deadline, time in microseconds
+ *
+ */
+uint64_t time_deadline_after(uint64_t microseconds){
+	return time_in_microseconds_64() + microseconds;
+}
+
+
+/*!\brief Check deadline.
+ *
+ * \details Checks if deadline has expired.
+ *
+ *
+ * @param deadline - deadline, time in microseconds.
+ * @return 1 if expired, 0 otherwise
+ *
+ */
+uint8_t time_deadline_expired(uint64_t deadline){
+	return (time_in_microseconds_64() >= deadline) ? 1 : 0;
+}
+
+
+/*!\brief Time until deadline.
+ *
+ * \details Returns time left until deadline.
+ *
+ *
+ * @param deadline - deadline, time in microseconds.
+ * @return time left in microseconds, 0 if expired
+ *
+ */
+uint64_t time_until_deadline(uint64_t deadline){
+	uint64_t current_time = time_in_microseconds_64();
+
+	return (current_time >= deadline) ? 0 : (deadline - current_time);
+}
+
+
+/*!\brief Start a periodic interval.
+ *
+ * \details Initializes interval, first due one period after current time.
+ *
+ *
+ * @param interval - interval to start.
+ * @param period_in_microseconds - period in microseconds.
+ *
+ */
+void time_interval_start(TIME_INTERVAL *interval, uint64_t period_in_microseconds){
+	interval->period = period_in_microseconds;
+	interval->next_time = time_deadline_after(period_in_microseconds);
+}
+
+
+/*!\brief Check a periodic interval.
+ *
+ * \details Checks if interval is due; when due, next time is advanced by the period from the previous due time, so
+ * intervals do not drift with the time of the check. Periods missed are skipped.
+ *
+ *
+ * @param interval - interval to check.
+ * @return 1 if due, 0 otherwise
+ *
+ */
+uint8_t time_interval_due(TIME_INTERVAL *interval){
+	uint64_t current_time = time_in_microseconds_64();
+
+	if (current_time < interval->next_time){
+		return 0;
+	}
+	interval->next_time += interval->period;
+	if (interval->next_time <= current_time){
+		/*Missed periods*/
+		interval->next_time = current_time + interval->period;
+	}
+	return 1;
+}
+
+
+/*!\brief Start a timer callback.
+ *
+ * \details Calls function after a delay, and then every period if period is not 0. A periodic callback does not
+ * drift, each expiry is a period after the previous expiry. Delay and period are rounded up to TIMER0 counts i.e.
+ * 4μs; a period shorter than TIMER_CALLBACK_MINIMUM_PERIOD_IN_MICROSECONDS is extended to it. An active callback is
+ * restarted. Can be called from a task, or an ISR including a callback.
+ *
+ * \note In ISR context, function is called with interrupts disabled at the expiry time; in deferred context, it is
+ * called by the worker task, and a call is dropped if the worker queue is full or the worker is not started.
+ *
+ *
+ * @param timer - callback, owned by the caller.
+ * @param delay_in_microseconds - delay of the first call in microseconds, 0 to call at once.
+ * @param period_in_microseconds - period in microseconds, 0 for a one-shot callback.
+ * @param function - function to call.
+ * @param argument - argument of function.
+ * @param context - context function is called in.
+ *
+ */
+void timer_callback_start(TIMER_CALLBACK *timer, uint32_t delay_in_microseconds, uint32_t period_in_microseconds,
+		TIMER_CALLBACK_FUNCTION function, void *argument, TIMER_CALLBACK_CONTEXT context){
+	uint32_t total_counts = 0;
+	uint8_t backup_SREG = SREG, timer_counter = 0;
+
+	if ((period_in_microseconds > 0) && (period_in_microseconds < TIMER_CALLBACK_MINIMUM_PERIOD_IN_MICROSECONDS))
+		period_in_microseconds = TIMER_CALLBACK_MINIMUM_PERIOD_IN_MICROSECONDS;
+
+	cli();
+	timer_wheel_remove(timer);
+
+	timer->function = function;
+	timer->argument = argument;
+	timer->context = context;
+	timer->period_counts = (period_in_microseconds + TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT - 1)
+			/ TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT;
+
+	/*Current time in overflows and counts, as time_in_microseconds_64()*/
+	timer->expiry_overflow = (uint32_t) timer_counter_timer0.timer0_overflow_counter;
+	timer_counter = TCNT0;
+	if ((TIFR0 & _BV(TOV0)) && (timer_counter < 255))
+		timer->expiry_overflow++;
+
+	total_counts = timer_counter + (delay_in_microseconds + TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT - 1)
+			/ TIME_IN_MICROSECONDS_FOR_TIMER0_COUNT;
+	timer->expiry_overflow += total_counts >> 8;
+	timer->expiry_count = (uint8_t) total_counts;
+
+	timer_wheel_insert(timer);
+	timer_compare_dispatch();
+
+	SREG = backup_SREG;
+}
+
+
+/*!\brief Stop a timer callback.
+ *
+ * \details Stops a one-shot or periodic callback; nothing is done if it is not active. A deferred call already sent
+ * to the worker task is still made.
+ *
+ *
+ * @param timer - callback to stop.
+ *
+ */
+void timer_callback_stop(TIMER_CALLBACK *timer){
+	uint8_t backup_SREG = SREG;
+
+	cli();
+	timer_wheel_remove(timer);
+	SREG = backup_SREG;
+}
+
+
+/*!\brief Check a timer callback.
+ *
+ * \details Checks if callback is active, i.e. waiting for its expiry. A one-shot callback is inactive once fired.
+ *
+ *
+ * @param timer - callback to check.
+ * @return 1 if active, 0 otherwise
+ *
+ */
+uint8_t timer_callback_active(TIMER_CALLBACK *timer){
+	return (timer->state != TIMER_CALLBACK_INACTIVE) ? 1 : 0;
+}
+
+
+/*!\brief Start the worker task of deferred callbacks.
+ *
+ * \details Creates worker queue and task, which calls deferred callbacks in the order of expiry. Call once, before
+ * the first deferred callback expires.
+ *
+ *
+ * @param priority - priority of worker task.
+ * @param stack_depth - stack depth of worker task, enough for the deferred callbacks.
+ * @return 1 if started, 0 otherwise
+ *
+ */
+uint8_t timer_callback_start_worker(UBaseType_t priority, uint16_t stack_depth){
+	timer_worker_queue = xQueueCreate(TIMER_CALLBACK_WORKER_QUEUE_LENGTH, sizeof(TIMER_CALLBACK *));
+	if (timer_worker_queue == NULL){
+		return 0;
+	}
+	return (xTaskCreate(timer_callback_worker, (const portCHAR *)"TimerWorker", stack_depth, NULL, priority, NULL)
+			== pdPASS) ? 1 : 0;
 }
 
 
@@ -285,7 +655,221 @@ void delay_milliseconds(unsigned long milliseconds){
 /*(Doxygen help: use \brief to provide short summary, \details for detailed description and \param for parameters */
 
 
-/*NO LOCAL FUNCTIONS*/
+/*!\brief Insert a callback on the wheel.
+ *
+ * \details Pushes callback at the head of the slot of its expiry overflow, O(1); rounds count the turns of the wheel
+ * before expiry. A callback due in current overflow, or overdue, goes to compare list instead.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @param timer - callback to insert.
+ *
+ */
+void timer_wheel_insert(TIMER_CALLBACK *timer){
+	uint32_t current_overflow = (uint32_t) timer_counter_timer0.timer0_overflow_counter;
+	int32_t overflows_to_expiry = (int32_t) (timer->expiry_overflow - current_overflow);
+	uint8_t slot = 0;
+
+	if (overflows_to_expiry <= 0){
+		if (overflows_to_expiry < 0)
+			timer->expiry_count = 0;		/*Overdue, fire first*/
+		timer_compare_insert(timer);
+		return;
+	}
+
+	slot = timer->expiry_overflow & TIMER_WHEEL_SLOT_MASK;
+	timer->rounds = (uint32_t) (overflows_to_expiry - 1) / TIMER_WHEEL_SLOTS;
+	timer->previous = NULL;
+	timer->next = timer_wheel[slot];
+	if (timer->next != NULL)
+		timer->next->previous = timer;
+	timer_wheel[slot] = timer;
+	timer->state = TIMER_CALLBACK_ON_WHEEL;
+}
+
+
+/*!\brief Remove a callback.
+ *
+ * \details Unlinks callback from its wheel slot, O(1), or from compare list, which holds only callbacks of current
+ * overflow. Nothing is done if callback is inactive.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @param timer - callback to remove.
+ *
+ */
+void timer_wheel_remove(TIMER_CALLBACK *timer){
+	TIMER_CALLBACK **link = &timer_compare_list;
+
+	if (timer->state == TIMER_CALLBACK_ON_WHEEL){
+		if (timer->previous != NULL)
+			timer->previous->next = timer->next;
+		else
+			timer_wheel[timer->expiry_overflow & TIMER_WHEEL_SLOT_MASK] = timer->next;
+		if (timer->next != NULL)
+			timer->next->previous = timer->previous;
+	}
+	else if (timer->state == TIMER_CALLBACK_IN_COMPARE_LIST){
+		while ((*link != NULL) && (*link != timer))
+			link = &(*link)->next;
+		if (*link != NULL)
+			*link = timer->next;
+	}
+	timer->state = TIMER_CALLBACK_INACTIVE;
+}
+
+
+/*!\brief Advance the wheel.
+ *
+ * \details Called on each TIMER0 overflow. Callbacks left in compare list belong to the previous overflow, and are
+ * set to fire at once. Callbacks of the slot of current overflow either count down a round, or are moved to compare list;
+ * then the due ones are fired and compare match is set for the rest.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @return void
+ *
+ */
+void timer_wheel_advance(void){
+	uint8_t slot = (uint8_t) timer_counter_timer0.timer0_overflow_counter & TIMER_WHEEL_SLOT_MASK;
+	TIMER_CALLBACK *timer = timer_compare_list;
+	TIMER_CALLBACK *next_timer = NULL;
+
+	/*Overdue, fired first*/
+	while (timer != NULL){
+		timer->expiry_count = 0;
+		timer = timer->next;
+	}
+
+	timer = timer_wheel[slot];
+	while (timer != NULL){
+		next_timer = timer->next;
+		if (timer->rounds > 0){
+			timer->rounds--;
+		}
+		else{
+			timer_wheel_remove(timer);
+			timer_compare_insert(timer);
+		}
+		timer = next_timer;
+	}
+
+	timer_compare_dispatch();
+}
+
+
+/*!\brief Insert a callback in compare list.
+ *
+ * \details Inserts callback sorted by expiry count, after callbacks of the same count.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @param timer - callback to insert.
+ *
+ */
+void timer_compare_insert(TIMER_CALLBACK *timer){
+	TIMER_CALLBACK **link = &timer_compare_list;
+
+	while ((*link != NULL) && ((*link)->expiry_count <= timer->expiry_count))
+		link = &(*link)->next;
+	timer->next = *link;
+	*link = timer;
+	timer->state = TIMER_CALLBACK_IN_COMPARE_LIST;
+}
+
+
+/*!\brief Dispatch compare list.
+ *
+ * \details Fires callbacks whose count TIMER0 has reached, and sets OCR0A compare match for the next one. If TIMER0
+ * passes the count while it is set, the callback is fired here instead. With an overflow pending, all callbacks of
+ * compare list are due, and are left to the overflow ISR.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @return void
+ *
+ */
+void timer_compare_dispatch(void){
+	TIMER_CALLBACK *timer = NULL;
+
+	while (timer_compare_list != NULL){
+		if (TIFR0 & _BV(TOV0)){
+			/*Overflow pending*/
+			break;
+		}
+		if (timer_compare_list->expiry_count > TCNT0){
+			OCR0A = timer_compare_list->expiry_count;
+			/*Clear a stale compare match, write 1 to the flag only so overflow flag is kept*/
+			TIFR0 = _BV(OCF0A);
+			SET_BIT(TIMSK0, OCIE0A);
+			if (timer_compare_list->expiry_count > TCNT0)
+				return;
+		}
+		timer = timer_compare_list;
+		timer_compare_list = timer->next;
+		timer_callback_fire(timer);
+	}
+	CLEAR_BIT(TIMSK0, OCIE0A);
+}
+
+
+/*!\brief Fire a callback.
+ *
+ * \details A periodic callback is first inserted again at its next expiry, a period after this expiry. Then function
+ * is called, or sent to the worker task if deferred.
+ *
+ * \note Called with interrupts disabled.
+ *
+ *
+ * @param timer - callback to fire.
+ *
+ */
+void timer_callback_fire(TIMER_CALLBACK *timer){
+	uint32_t total_counts = 0;
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	timer->state = TIMER_CALLBACK_INACTIVE;
+	if (timer->period_counts > 0){
+		total_counts = timer->expiry_count + timer->period_counts;
+		timer->expiry_overflow += total_counts >> 8;
+		timer->expiry_count = (uint8_t) total_counts;
+		timer_wheel_insert(timer);
+	}
+
+	if (timer->context == TIMER_CALLBACK_DEFERRED){
+		if (timer_worker_queue != NULL){
+			xQueueSendFromISR(timer_worker_queue, &timer, &higher_priority_task_woken);
+			/*Worker runs at the next tick, the ISR does not switch tasks*/
+		}
+	}
+	else{
+		timer->function(timer->argument);
+	}
+}
+
+
+/*!\brief Worker task of deferred callbacks.
+ *
+ * \details Calls the deferred callbacks sent by timer_callback_fire(), in the order of expiry.
+ *
+ *
+ * @param parameters - not used.
+ *
+ */
+void timer_callback_worker(void *parameters){
+	TIMER_CALLBACK *timer = NULL;
+
+	(void) parameters;
+	for (;;){
+		if (xQueueReceive(timer_worker_queue, &timer, portMAX_DELAY) == pdTRUE)
+			timer->function(timer->argument);
+	}
+}
 
 
 /*---------------------------------------  ISR-Interrupt Service Routines  ---------------------------------------*/
@@ -304,6 +888,7 @@ void delay_milliseconds(unsigned long milliseconds){
  *
  */
 ISR(TIMER0_OVF_vect){
+	CPU_STATS_ISR_ENTER();
 	/*Copy these to local variables so they can be stored in registers*/
 	/*Volatile variables must be read from memory on every access*/
 	unsigned long time_milliseconds = timer_counter_timer0.timer0_time_in_milliseconds;
@@ -319,6 +904,27 @@ ISR(TIMER0_OVF_vect){
 	timer_counter_timer0.timer0_time_fraction = time_milliseconds_fraction;
 	timer_counter_timer0.timer0_time_in_milliseconds = time_milliseconds;
 	timer_counter_timer0.timer0_overflow_counter++;
+
+	/*Timer wheel*/
+	timer_wheel_advance();
+
+	CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER0);
+}
+
+
+/*!\brief TIMER0 compare match A ISR (Interrupt Service Routine).
+ *
+ * \details Interrupt Service Routine, fires the callbacks of compare list due at the count of OCR0A.
+ *
+ *
+ *
+ * @return void
+ *
+ */
+ISR(TIMER0_COMPA_vect){
+	CPU_STATS_ISR_ENTER();
+	timer_compare_dispatch();
+	CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER0);
 }
 
 /*!@}*/   // end module
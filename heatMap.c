@@ -0,0 +1,104 @@
+/*
+ * heatMap.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file heatMap.c
+ *
+ * Module for the live thermal heat map web view, called by main Chico module
+ * The page draws each pixel row at the servo position it was read at, the sensor sweep builds up the map
+ ------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "include/heatMap.h"
+#include "include/thermalSensor.h"
+
+// page is sent in chunks, each chunk is a write to the WiFi module
+#define HEAT_MAP_PAGE_CHUNK_SIZE 120
+
+// heat map page, kept in flash
+// the map is 38 columns: 11 servo positions (1140 to 4140, steps of 300) of about 3 pixels each, plus the 8 pixels
+// of the row; pixels are colored from blue at ambient to red at 8 degrees above ambient
+static const char heatMapPage[] PROGMEM =
+	"<!DOCTYPE HTML><html><head><title>Chico Heat Map</title></head><body><center><h3>Chico Heat Map</h3>"
+	"<canvas id=\"c\" width=\"380\" height=\"40\"></canvas><p id=\"t\"></p></center><script>"
+	"var s=-1,p=[],x=document.getElementById(\"c\").getContext(\"2d\");"
+	"function u(){fetch(\"" HEAT_MAP_UPDATE_ROUTE "?s=\"+s).then(function(r){if(!r.ok)throw 0;return r.text();})"
+	".then(function(r){var a=r.split(\",\"),b=Math.max(0,Math.min(10,Math.round((a[1]-1140)/300))),i,e;"
+	"if(a[0][0]==\"K\"){for(i=0;i<9;i++)p[i]=+a[i+2];}"
+	"else{for(i=2;i<a.length;i++){e=a[i].split(\":\");p[e[0]]=+e[1];}}"
+	"s=a[0].slice(1);"
+	"for(i=1;i<9;i++){x.fillStyle=\"hsl(\"+Math.max(0,Math.min(240,240-(p[i]-p[0])*30))+\",100%,50%)\";"
+	"x.fillRect((b*3+8-i)*10,0,10,40);}"
+	"document.getElementById(\"t\").innerHTML=\"Ambient \"+p[0]+\" C\";setTimeout(u," HEAT_MAP_POLL_PERIOD ");})"
+	".catch(function(){s=-1;setTimeout(u,1000);});}"
+	"u();</script></body></html>";
+
+// sequence and values of the previous update, what a client in step has
+uint16_t heatMapSequence = 0;
+uint8_t heatMapValues[HEAT_MAP_VALUES];
+
+/*!\brief Encode a heat map update.
+ *
+ *\details Encodes a delta against the previous update if the client has it, a keyframe otherwise,
+ * refer heatMap.h for the format. Unchanged values cost nothing, only the servo position is always sent.
+ * Returns the length of the update.
+ */
+int encodeHeatMapUpdate(char *buffer, long clientSequence, const uint8_t *values, uint16_t servoPosition) {
+	int length;
+	int keyframe = (clientSequence != heatMapSequence);
+
+	heatMapSequence++;
+	length = sprintf(buffer, "%c%u,%u", keyframe ? 'K' : 'D', heatMapSequence, servoPosition);
+	for (int i = 0; i < HEAT_MAP_VALUES; i++) {
+		if (keyframe) {
+			length += sprintf(&buffer[length], ",%u", values[i]);
+		}
+		else if (values[i] != heatMapValues[i]) {
+			length += sprintf(&buffer[length], ",%d:%u", i, values[i]);
+		}
+		heatMapValues[i] = values[i];
+	}
+	return length;
+}
+
+/*!\brief Serve the heat map page.
+ *
+ *\details Web route /heatmap, sends the page from flash in chunks.
+ */
+void serveHeatMapPage(TCP_SOCKET socket, char *query) {
+	char buffer[HEAT_MAP_PAGE_CHUNK_SIZE + 1];
+	size_t pageSize = strlen_P(heatMapPage);
+
+	send_http_response_header(socket, "200 OK", "text/html");
+	for (size_t i = 0; i < pageSize; i += HEAT_MAP_PAGE_CHUNK_SIZE) {
+		strncpy_P(buffer, heatMapPage + i, HEAT_MAP_PAGE_CHUNK_SIZE);
+		buffer[HEAT_MAP_PAGE_CHUNK_SIZE] = '\0';
+		send_http_response_data(socket, buffer);
+	}
+}
+
+/*!\brief Serve a heat map update.
+ *
+ *\details Web route /thermal?s=<sequence>, responds with the latest frame read by thermal task.
+ * Header and update go in one write without content type, so a response costs around 50 bytes on the UART;
+ * the request of the browser costs several hundred bytes in, which limits polling to HEAT_MAP_POLL_PERIOD.
+ */
+void serveHeatMapUpdate(TCP_SOCKET socket, char *query) {
+	char buffer[HEAT_MAP_UPDATE_SIZE];
+	ThermalFrame frame;
+	long clientSequence = -1;
+
+	if (query[0] == 's' && query[1] == '=') {
+		clientSequence = strtol(&query[2], NULL, 10);
+	}
+	// values and servo position of the same frame
+	getThermalFrame(&frame);
+	encodeHeatMapUpdate(buffer, clientSequence, frame.values, frame.servoPosition);
+	send_http_response(socket, "200 OK", NULL, buffer);
+}
@@ -0,0 +1,309 @@
+/*
+ * telemetry_collector.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file telemetry_collector.c
+ *
+ * Linux collector of the telemetry frames pushed by the robots over UDP, refer include/telemetry.h
+ * All robots send to the same port; each is tracked on its own by robot id, so any number of robots are
+ * collected at the same time, and the gaps in the sequence of each are detected and logged.
+ * Frames are checked with checkTelemetryFrame() as on the robot, and appended to a columnar log, a directory with one file per column: the values of a column are
+ * stored one after the other, little-endian, and row i of every file is frame i. columns.txt lists the
+ * columns and their types, gaps.csv lists the gaps.
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -Wall -Itest/stubs -I. host/telemetry_collector.c host/telemetry_host.c telemetryFormat.c \
+ *     -o telemetry_collector
+ *   ./telemetry_collector 5005 telemetry_log
+ * Stop with Ctrl-C, the columns are flushed and a summary of each robot is printed.
+ * The file is empty for the AVR build, so the robot project can keep it in its tree.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "host/telemetry_host.h"
+
+// robots tracked at the same time
+#define COLLECTOR_ROBOTS 256
+// frames buffered before the columns are written, and longest time a frame stays in the buffer in ms
+#define COLLECTOR_BLOCK 256
+#define COLLECTOR_FLUSH_PERIOD 1000
+// receive buffer of the socket, so bursts from many robots are not dropped while the columns are written
+#define COLLECTOR_RECEIVE_BUFFER (1024 * 1024)
+#define COLLECTOR_PATH_SIZE 512
+
+typedef struct {
+	const char *name;
+	const char *type;
+	int size;
+	FILE *file;
+	uint8_t data[COLLECTOR_BLOCK * 8];
+} Column;
+
+// column order of the log
+enum {
+	COLUMN_ROBOT, COLUMN_SEQUENCE, COLUMN_TIME, COLUMN_ARRIVAL, COLUMN_DISTANCE, COLUMN_SPEED, COLUMN_SONAR,
+	COLUMN_COMMAND, COLUMN_STATE, COLUMN_THERMAL, COLUMN_COUNT = COLUMN_THERMAL + TELEMETRY_THERMAL_PIXELS
+};
+
+Column columns[COLUMN_COUNT] = {
+	{"robot", "uint16", 2},
+	{"sequence", "uint16", 2},
+	{"time", "uint32 ms since start of the robot", 4},
+	{"arrival", "uint64 ms since 1970 at the collector", 8},
+	{"distance", "uint16 cm", 2},
+	{"speed", "uint16 mm/s", 2},
+	{"sonar", "uint16 mm", 2},
+	{"command", "uint8", 1},
+	{"state", "uint8", 1},
+	{"ambient", "uint8 degree C", 1},
+	{"pixel1", "uint8 degree C", 1},
+	{"pixel2", "uint8 degree C", 1},
+	{"pixel3", "uint8 degree C", 1},
+	{"pixel4", "uint8 degree C", 1},
+	{"pixel5", "uint8 degree C", 1},
+	{"pixel6", "uint8 degree C", 1},
+	{"pixel7", "uint8 degree C", 1},
+	{"pixel8", "uint8 degree C", 1},
+};
+int blockRows = 0;
+
+TelemetryStream streams[COLLECTOR_ROBOTS];
+int streamCount = 0;
+FILE *gapLog;
+uint32_t rejected = 0;
+volatile sig_atomic_t stopping = 0;
+
+void stopCollector(int signalNumber) {
+	stopping = 1;
+}
+
+uint64_t timeInMilliseconds(void) {
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+/*!\brief Open the columnar log
+ *
+ *\details Creates the directory if needed and opens each column for append, so a restarted collector
+ * continues the log; writes columns.txt and the header of gaps.csv for a new log.
+ * return int 1 if open, 0 otherwise.
+ */
+int openLog(const char *directory) {
+	char path[COLLECTOR_PATH_SIZE];
+	FILE *schema;
+	int newLog;
+
+	if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+		perror(directory);
+		return 0;
+	}
+	for (int i = 0; i < COLUMN_COUNT; i++) {
+		snprintf(path, sizeof(path), "%s/%s.col", directory, columns[i].name);
+		columns[i].file = fopen(path, "ab");
+		if (columns[i].file == NULL) {
+			perror(path);
+			return 0;
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/columns.txt", directory);
+	schema = fopen(path, "w");
+	if (schema == NULL) {
+		perror(path);
+		return 0;
+	}
+	for (int i = 0; i < COLUMN_COUNT; i++) {
+		fprintf(schema, "%s.col %s\n", columns[i].name, columns[i].type);
+	}
+	fclose(schema);
+
+	snprintf(path, sizeof(path), "%s/gaps.csv", directory);
+	gapLog = fopen(path, "a");
+	if (gapLog == NULL) {
+		perror(path);
+		return 0;
+	}
+	newLog = (ftell(gapLog) == 0);
+	if (newLog) {
+		fprintf(gapLog, "arrival,robot,first_missing_sequence,missing\n");
+	}
+	return 1;
+}
+
+/*!\brief Add a value to a column
+ *
+ *\details Stores the value in the block of the column, low byte first.
+ */
+void addColumnValue(Column *column, uint64_t value) {
+	uint8_t *cell = &column->data[blockRows * column->size];
+
+	for (int i = 0; i < column->size; i++) {
+		cell[i] = (uint8_t) (value >> (8 * i));
+	}
+}
+
+/*!\brief Write the buffered records
+ *
+ *\details Appends the block of each column to its file; the gaps are flushed too, so the log is consistent
+ * up to the last flush if the collector is killed.
+ */
+void flushLog(void) {
+	for (int i = 0; i < COLUMN_COUNT; i++) {
+		if (blockRows > 0) {
+			fwrite(columns[i].data, columns[i].size, blockRows, columns[i].file);
+		}
+		fflush(columns[i].file);
+	}
+	fflush(gapLog);
+	blockRows = 0;
+}
+
+void addRecord(const TelemetryRecord *record, uint64_t arrival) {
+	addColumnValue(&columns[COLUMN_ROBOT], record->robotId);
+	addColumnValue(&columns[COLUMN_SEQUENCE], record->sequence);
+	addColumnValue(&columns[COLUMN_TIME], record->time);
+	addColumnValue(&columns[COLUMN_ARRIVAL], arrival);
+	addColumnValue(&columns[COLUMN_DISTANCE], record->distance);
+	addColumnValue(&columns[COLUMN_SPEED], record->speed);
+	addColumnValue(&columns[COLUMN_SONAR], record->sonar);
+	addColumnValue(&columns[COLUMN_COMMAND], record->command);
+	addColumnValue(&columns[COLUMN_STATE], record->state);
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		addColumnValue(&columns[COLUMN_THERMAL + i], record->thermal[i]);
+	}
+	blockRows++;
+	if (blockRows == COLLECTOR_BLOCK) {
+		flushLog();
+	}
+}
+
+/*!\brief Find the stream of a robot
+ *
+ *\details Starts a stream for a new robot. return Stream, NULL when COLLECTOR_ROBOTS are tracked already.
+ */
+TelemetryStream *findStream(uint16_t robotId) {
+	for (int i = 0; i < streamCount; i++) {
+		if (streams[i].robotId == robotId) {
+			return &streams[i];
+		}
+	}
+	if (streamCount == COLLECTOR_ROBOTS) {
+		return NULL;
+	}
+	initTelemetryStream(&streams[streamCount], robotId);
+	return &streams[streamCount++];
+}
+
+/*!\brief Collect a datagram
+ *
+ *\details Decodes the frame, tracks the sequence of its robot and logs it; a gap is logged with the
+ * first missing sequence, a late frame is logged as it is. A datagram carries one frame.
+ */
+void collectDatagram(const uint8_t *datagram, int length, const struct sockaddr_in *sender) {
+	TelemetryRecord record;
+	TelemetryStream *stream;
+	uint64_t arrival = timeInMilliseconds();
+	int missing;
+
+	if (decodeTelemetryFrame(datagram, length, &record) != length || (stream = findStream(record.robotId)) == NULL) {
+		rejected++;
+		return;
+	}
+	if (stream->received == 0) {
+		fprintf(stderr, "robot %u at %s\n", record.robotId, inet_ntoa(sender->sin_addr));
+	}
+	missing = trackTelemetryStream(stream, &record);
+	if (missing > 0) {
+		fprintf(gapLog, "%llu,%u,%u,%d\n", (unsigned long long) arrival, record.robotId,
+			(uint16_t) (record.sequence - missing), missing);
+		fprintf(stderr, "robot %u: %d frames missing before %u\n", record.robotId, missing, record.sequence);
+	}
+	addRecord(&record, arrival);
+}
+
+void printSummary(void) {
+	for (int i = 0; i < streamCount; i++) {
+		fprintf(stderr, "robot %u: %u received, %u missing, %u late, %u restarts\n", streams[i].robotId,
+			streams[i].received, streams[i].missing, streams[i].late, streams[i].restarts);
+	}
+	fprintf(stderr, "%u datagrams rejected\n", rejected);
+}
+
+int main(int argc, char **argv) {
+	struct sockaddr_in address;
+	struct sockaddr_in sender;
+	socklen_t senderSize;
+	struct pollfd socketPoll;
+	uint8_t datagram[512];
+	uint64_t lastFlush;
+	int receiveBuffer = COLLECTOR_RECEIVE_BUFFER;
+	int length;
+	int udp;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <udp port> <log directory>\n", argv[0]);
+		return 2;
+	}
+	if (!openLog(argv[2])) {
+		return 1;
+	}
+
+	udp = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(atoi(argv[1]));
+	setsockopt(udp, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+	if (udp < 0 || bind(udp, (struct sockaddr *) &address, sizeof(address)) != 0) {
+		perror("bind");
+		return 1;
+	}
+
+	signal(SIGINT, stopCollector);
+	signal(SIGTERM, stopCollector);
+	socketPoll.fd = udp;
+	socketPoll.events = POLLIN;
+	lastFlush = timeInMilliseconds();
+	while (!stopping) {
+		if (poll(&socketPoll, 1, COLLECTOR_FLUSH_PERIOD) > 0) {
+			// take all datagrams waiting, from any robot
+			for (;;) {
+				senderSize = sizeof(sender);
+				length = recvfrom(udp, datagram, sizeof(datagram), MSG_DONTWAIT, (struct sockaddr *) &sender,
+					&senderSize);
+				if (length < 0) {
+					break;
+				}
+				collectDatagram(datagram, length, &sender);
+			}
+		}
+		if (timeInMilliseconds() - lastFlush >= COLLECTOR_FLUSH_PERIOD) {
+			flushLog();
+			lastFlush = timeInMilliseconds();
+		}
+	}
+
+	flushLog();
+	printSummary();
+	close(udp);
+	return 0;
+}
+
+#endif /* __AVR__ */
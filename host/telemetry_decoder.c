@@ -0,0 +1,45 @@
+/*
+ * telemetry_decoder.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file telemetry_decoder.c
+ *
+ * Decoder of a capture of telemetry frames into CSV, refer include/telemetry.h
+ * A capture is any byte stream holding frames, e.g. the output of the console command Z, or the datagrams
+ * of the collector stream written one after the other; refer decodeTelemetryCapture() of telemetry_host.c.
+ * Sample frames are written as CSV, one line per frame.
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -Wall -Itest/stubs -I. host/telemetry_decoder.c host/telemetry_host.c telemetryFormat.c \
+ *     -o telemetry_decoder
+ *   ./telemetry_decoder capture.bin > capture.csv
+ * Without a file, the capture is read from stdin. The number of frames and skipped bytes goes to stderr.
+ * The file is empty for the AVR build, so the robot project can keep it in its tree.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <stdio.h>
+
+#include "host/telemetry_host.h"
+
+int main(int argc, char **argv) {
+	FILE *capture = stdin;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [capture]\n", argv[0]);
+		return 2;
+	}
+	if (argc == 2) {
+		capture = fopen(argv[1], "rb");
+		if (capture == NULL) {
+			perror(argv[1]);
+			return 1;
+		}
+	}
+	decodeTelemetryCapture(capture, stdout);
+	return 0;
+}
+
+#endif /* __AVR__ */
@@ -0,0 +1,196 @@
+/*
+ * telemetry_host.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file telemetry_host.c
+ *
+ * Host side of the telemetry frames: decoding and CSV output, and gap detection on the sequence numbers of a robot.
+ * Frames are validated with checkTelemetryFrame() of telemetryFormat.c, as on the robot.
+ * Used by the collector, the decoder and the host tests; the file is empty for the AVR build.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <string.h>
+
+#include "host/telemetry_host.h"
+
+// largest frame, with a payload of 255 bytes
+#define DECODER_FRAME_MAX (TELEMETRY_HEADER_SIZE + 255 + TELEMETRY_CRC_SIZE)
+#define DECODER_BUFFER_SIZE (4 * DECODER_FRAME_MAX)
+
+/*!\brief Read a 16 bit value
+ *
+ *\details Read value from buffer, low byte first.
+ */
+uint16_t getTelemetry16(const uint8_t *buffer) {
+	return buffer[0] | (buffer[1] << 8);
+}
+
+/*!\brief Read a 32 bit value
+ *
+ *\details Read value from buffer, low byte first.
+ */
+uint32_t getTelemetry32(const uint8_t *buffer) {
+	return getTelemetry16(buffer) | ((uint32_t) getTelemetry16(buffer + 2) << 16);
+}
+
+/*!\brief Decode a telemetry frame
+ *
+ *\details Reverse of buildTelemetryFrame(), refer telemetry.h for the layout.
+ * @param length Bytes available in frame.
+ * return int Frame size in bytes if a valid sample frame, 0 otherwise; frames of other types are skipped with it.
+ */
+int decodeTelemetryFrame(const uint8_t *frame, int length, TelemetryRecord *record) {
+	int frameSize = checkTelemetryFrame(frame, length);
+	const uint8_t *payload = frame + TELEMETRY_HEADER_SIZE;
+
+	if (frameSize == 0 || frame[2] != TELEMETRY_TYPE_SAMPLE || frame[3] != TELEMETRY_SAMPLE_SIZE) {
+		return 0;
+	}
+	record->robotId = getTelemetry16(frame + 4);
+	record->sequence = getTelemetry16(frame + 6);
+	record->time = getTelemetry32(frame + 8);
+	record->distance = getTelemetry16(payload);
+	record->speed = getTelemetry16(payload + 2);
+	record->sonar = getTelemetry16(payload + 4);
+	record->command = payload[6];
+	record->state = payload[7];
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		record->thermal[i] = payload[8 + i];
+	}
+	return frameSize;
+}
+
+/*!\brief Write the CSV header
+ *
+ *\details Column names with their units, one column per field of the sample.
+ */
+void writeTelemetryCsvHeader(FILE *csv) {
+	fprintf(csv, "robot,sequence,time_ms,distance_cm,speed_mm_s,sonar_mm,command,state,ambient_c");
+	for (int i = 1; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		fprintf(csv, ",pixel%d_c", i);
+	}
+	fprintf(csv, "\n");
+}
+
+/*!\brief Write a frame as CSV
+ *
+ *\details One line, in the order of writeTelemetryCsvHeader().
+ */
+void writeTelemetryCsv(FILE *csv, const TelemetryRecord *record) {
+	fprintf(csv, "%u,%u,%u,%u,%u,%u,%u,%u", record->robotId, record->sequence, record->time, record->distance,
+		record->speed, record->sonar, record->command, record->state);
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		fprintf(csv, ",%u", record->thermal[i]);
+	}
+	fprintf(csv, "\n");
+}
+
+/*!\brief Decode a capture
+ *
+ *\details Reads the capture in blocks and writes the sample frames as CSV. Looks for the sync byte and checks the
+ * frame with checkTelemetryFrame(); on a bad frame continues at the next byte, so noise between frames and
+ * corrupted frames are skipped. A frame may span blocks, the bytes from its sync are kept until the frame
+ * is complete or the capture ends. The number of frames and skipped bytes goes to stderr.
+ * return int Number of frames decoded.
+ */
+int decodeTelemetryCapture(FILE *capture, FILE *csv) {
+	uint8_t buffer[DECODER_BUFFER_SIZE];
+	TelemetryRecord record;
+	int count = 0;
+	int position;
+	int frameSize;
+	int frames = 0;
+	int otherFrames = 0;
+	long skipped = 0;
+	int endOfCapture = 0;
+
+	writeTelemetryCsvHeader(csv);
+	while (!endOfCapture) {
+		int bytesRead = fread(buffer + count, 1, DECODER_BUFFER_SIZE - count, capture);
+		count += bytesRead;
+		endOfCapture = (bytesRead == 0);
+		position = 0;
+		while (position < count) {
+			if (buffer[position] != TELEMETRY_SYNC) {
+				position++;
+				skipped++;
+				continue;
+			}
+			// wait for the rest of the frame, unless the capture ends
+			if (!endOfCapture && (count - position < TELEMETRY_HEADER_SIZE
+				|| count - position < TELEMETRY_HEADER_SIZE + buffer[position + 3] + TELEMETRY_CRC_SIZE)) {
+				break;
+			}
+			frameSize = checkTelemetryFrame(buffer + position, count - position);
+			if (frameSize == 0) {
+				position++;
+				skipped++;
+			}
+			else if (decodeTelemetryFrame(buffer + position, frameSize, &record)) {
+				writeTelemetryCsv(csv, &record);
+				frames++;
+				position += frameSize;
+			}
+			else {
+				otherFrames++;
+				position += frameSize;
+			}
+		}
+		memmove(buffer, buffer + position, count - position);
+		count -= position;
+	}
+
+	fprintf(stderr, "%d frames, %d frames of other types, %ld bytes skipped\n", frames, otherFrames, skipped);
+	return frames;
+}
+
+/*!\brief Initialize a stream
+ *
+ *\details No frame received yet from the robot.
+ */
+void initTelemetryStream(TelemetryStream *stream, uint16_t robotId) {
+	stream->robotId = robotId;
+	stream->started = 0;
+	stream->nextSequence = 0;
+	stream->lastTime = 0;
+	stream->received = 0;
+	stream->missing = 0;
+	stream->late = 0;
+	stream->restarts = 0;
+}
+
+/*!\brief Track the sequence of a stream
+ *
+ *\details The robot counts sequence numbers on, even while it cannot send, so a jump ahead is a gap.
+ * A sequence shortly behind the stream is a late or duplicate datagram. When the robot time goes back
+ * otherwise, the robot restarted and counts from 0 again, which is not a gap. Sequence numbers wrap at 65536.
+ * return int Frames missing before this one, 0 without gap, -1 for a late frame.
+ */
+int trackTelemetryStream(TelemetryStream *stream, const TelemetryRecord *record) {
+	uint16_t ahead = record->sequence - stream->nextSequence;
+	uint16_t behind = stream->nextSequence - record->sequence;
+	int missing = 0;
+
+	if (stream->started && ahead >= 0x8000 && (record->time >= stream->lastTime || behind <= TELEMETRY_LATE_WINDOW)) {
+		stream->late++;
+		return -1;
+	}
+	if (stream->started && record->time < stream->lastTime) {
+		stream->restarts++;
+	}
+	else if (stream->started) {
+		missing = ahead;
+		stream->missing += ahead;
+	}
+	stream->started = 1;
+	stream->nextSequence = record->sequence + 1;
+	stream->lastTime = record->time;
+	stream->received++;
+	return missing;
+}
+
+#endif /* __AVR__ */
@@ -0,0 +1,52 @@
+/*
+ * telemetry_host.h
+ *
+ * Host side of the telemetry frames, for the collector, the decoder and the host tests; refer include/telemetry.h
+ * for the layout.
+ */
+
+#ifndef HOST_TELEMETRY_HOST_H_
+#define HOST_TELEMETRY_HOST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "include/telemetry.h"
+
+// a frame at most this far behind its stream is late, not a restart of the robot, refer trackTelemetryStream()
+#define TELEMETRY_LATE_WINDOW 64
+
+// a decoded sample frame, in the units of the layout
+typedef struct {
+	uint16_t robotId;
+	uint16_t sequence;
+	uint32_t time;		// ms since start of the robot
+	uint16_t distance;	// cm
+	uint16_t speed;		// mm/s
+	uint16_t sonar;		// mm
+	uint8_t command;
+	uint8_t state;
+	uint8_t thermal[TELEMETRY_THERMAL_PIXELS];
+} TelemetryRecord;
+
+// frames of one robot, refer trackTelemetryStream()
+typedef struct {
+	uint16_t robotId;
+	uint8_t started;
+	uint16_t nextSequence;
+	uint32_t lastTime;
+	uint32_t received;
+	// frames lost in gaps, frames older than the stream, and restarts of the robot
+	uint32_t missing;
+	uint32_t late;
+	uint32_t restarts;
+} TelemetryStream;
+
+int decodeTelemetryFrame(const uint8_t *frame, int length, TelemetryRecord *record);
+void writeTelemetryCsvHeader(FILE *csv);
+void writeTelemetryCsv(FILE *csv, const TelemetryRecord *record);
+int decodeTelemetryCapture(FILE *capture, FILE *csv);
+void initTelemetryStream(TelemetryStream *stream, uint16_t robotId);
+int trackTelemetryStream(TelemetryStream *stream, const TelemetryRecord *record);
+
+#endif /* HOST_TELEMETRY_HOST_H_ */
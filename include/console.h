@@ -0,0 +1,48 @@
+/*
+ * console.h
+ *
+ */
+
+#ifndef INCLUDE_CONSOLE_H_
+#define INCLUDE_CONSOLE_H_
+
+#define CONSOLE_LINE_SIZE 64
+
+// console commands, moves use the same characters as the web page
+#define CONSOLE_INVALID 0
+#define CONSOLE_MOVE 1
+#define CONSOLE_QUERY_TEMPERATURE 2
+#define CONSOLE_QUERY_SONAR 3
+#define CONSOLE_QUERY_SPEED 4
+#define CONSOLE_QUERY_STATISTICS 5
+#define CONSOLE_HELP 6
+#define CONSOLE_QUERY_TELEMETRY 7
+#define CONSOLE_SCRIPT 8
+#define CONSOLE_QUERY_CPU 9
+#define CONSOLE_QUERY_OBSTACLE 10
+#define CONSOLE_QUERY_PANORAMA 11
+
+// approximate travel of one behavior cycle, forward 6 cycles is around 1 meter, spin 1 cycle is 90 degrees
+#define CONSOLE_CM_PER_CYCLE 17
+#define CONSOLE_DEGREES_PER_CYCLE 90
+// largest distance in cm or angle in degrees of a move
+#define CONSOLE_MAX_ARGUMENT 1000
+
+typedef struct {
+	char buffer[CONSOLE_LINE_SIZE];
+	int length;
+} ConsoleLine;
+
+typedef struct {
+	int type;
+	char move;
+	int cycles;
+	// motion script of CONSOLE_SCRIPT, points into the parsed line
+	const char *script;
+} ConsoleCommand;
+
+void consoleClearLine(ConsoleLine *line);
+int consoleAddChar(ConsoleLine *line, char c);
+int consoleParseLine(const char *line, ConsoleCommand *command);
+
+#endif /* INCLUDE_CONSOLE_H_ */
@@ -0,0 +1,53 @@
+/*
+ * cpuStats.h
+ *
+ */
+
+#ifndef INCLUDE_CPUSTATS_H_
+#define INCLUDE_CPUSTATS_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// FreeRTOSConfig.h counts task run time on the custom timer clock, in microseconds:
+//   #define configUSE_TRACE_FACILITY 1
+//   #define configGENERATE_RUN_TIME_STATS 1
+//   extern unsigned long time_in_microseconds(void);
+//   #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+//   #define portGET_RUN_TIME_COUNTER_VALUE() time_in_microseconds()
+// TIMER0 is started in main, before the scheduler, so the configure macro is empty.
+// Without them, no task is reported.
+
+// largest number of tasks reported, with headroom over the tasks of main and the idle task for the timer task or
+// a new task; with more tasks none is reported, refer getCpuStatsTasks()
+#define CPU_STATS_TASKS 12
+// length of a task name
+#define CPU_STATS_NAME_SIZE 13
+
+// interrupts with time accounting
+#define CPU_STATS_ISR_TIMER0 0
+#define CPU_STATS_ISR_TIMER4 1
+#define CPU_STATS_ISR_TIMER5 2
+#define CPU_STATS_ISR_SOURCES 3
+
+// microseconds per TIMER0 count, the unit of interrupt time
+#define CPU_STATS_MICROSECONDS_PER_COUNT 4
+
+// time spent in each interrupt, in TIMER0 counts, written by the interrupts only
+extern volatile uint32_t cpuStatsIsrCounts[CPU_STATS_ISR_SOURCES];
+
+// interrupt time accounting, enter at the start of an ISR and exit at the end; TIMER0 counts wrap every 1024 us,
+// longer than any ISR, and ISRs do not nest so the sum needs no critical section
+#define CPU_STATS_ISR_ENTER() uint8_t cpuStatsIsrStart = TCNT0
+#define CPU_STATS_ISR_EXIT(source) (cpuStatsIsrCounts[(source)] += (uint8_t) (TCNT0 - cpuStatsIsrStart))
+
+void addCpuStatsBusyWait(uint32_t microseconds);
+void updateCpuStats(void);
+uint32_t getCpuStatsWindow(void);
+int getCpuStatsTasks(int *total);
+uint16_t getCpuStatsTask(int index, char *name, uint16_t *stackFree);
+uint16_t getCpuStatsIdle(void);
+uint16_t getCpuStatsIsr(int source);
+uint16_t getCpuStatsBusyWait(void);
+
+#endif /* INCLUDE_CPUSTATS_H_ */
@@ -26,24 +26,37 @@
  * 	\brief This file declares the custom timer API functions.
  *
  * \details Functions such as providing tick time in microseconds, milliseconds, delay in milliseconds. This
- * module uses TIMER0 of ATMega2560 with a pre-scale of 64, and fast PWM mode.
+ * module uses TIMER0 of ATMega2560 with a pre-scale of 64, and normal mode. It also provides one-shot and periodic
+ * callbacks, on a timer wheel driven by TIMER0.
  *
  * ATMega2560 TC (Timer/Counter) is like a clock, and can be used to measure time events. All the timers depends on
  * the system clock of system, the system clock is 16MHz for ATMega2560. Timer0: Timer0 is a 8bit timer, and is capable
  * of counting 2^8 = 256 steps from 0 to 255 (TOP). It can operate in normal mode, CTC mode or PWM mode. TIMER0 is
  * configured with pre-scaler 64 at 250 KHz with a resolution of 4μs.
  *
- * Fast PWM Mode: The fast Pulse Width Modulation or fast PWM mode provides a high frequency PWM wave-form generation
- * option. The fast PWM differs from the other PWM option by its single-slope operation. The counter counts from BOTTOM
- * to TOP then restarts from BOTTOM. In fast PWM mode, the counter is incremented until the counter value matches the TOP
- * value. The counter is then cleared at the following timer clock cycle.
+ * Normal Mode: The counter counts from BOTTOM to MAX (255) then restarts from BOTTOM, setting the overflow flag; same
+ * overflow rate as fast PWM mode. Unlike fast PWM mode, compare register OCR0A is not double buffered, so a compare
+ * match can be set within the current count.
+ *
+ * Timer Wheel: callbacks are kept in 32 slots, a slot for each TIMER0 overflow (1024μs); a callback farther than 32
+ * overflows waits for rounds of the wheel. The overflow ISR moves callbacks due in this overflow to a compare list,
+ * sorted by count, and OCR0A compare match fires them at their count. Insert and expiry are O(1) on the wheel, the
+ * compare list holds only callbacks of the current overflow. Resolution is a count of TIMER0 i.e. 4μs.
  *
  * Module APIs:
- * 	- initialize_module_timer0(): initializes TIMER0 in fast PWM mode with pre-scale of 64, and activates it. Ensure this
+ * 	- initialize_module_timer0(): initializes TIMER0 in normal mode with pre-scale of 64, and activates it. Ensure this
  * 		is called at the beginning of program.
- * 	- time_in_microseconds(): returns time in microseconds.
+ * 	- time_in_microseconds(): returns time in microseconds, wraps after approximately 71 minutes.
+ * 	- time_in_microseconds_64(): returns time in microseconds, 64 bits; does not wrap.
  * 	- time_in_milliseconds(): returns time in milliseconds.
- * 	- delay_milliseconds(): accepts milliseconds and introduces required delay.
+ * 	- delay_milliseconds(): accepts milliseconds and introduces required delay; in a task, sleeps for whole ticks and
+ * 		spins only for the remainder.
+ * 	- time_microseconds_to_ticks(), time_ticks_to_microseconds(): convert durations to and from FreeRTOS ticks.
+ * 	- time_at_tick(), time_tick_at(): convert between FreeRTOS tick count and time in microseconds.
+ * 	- time_deadline_after(), time_deadline_expired(), time_until_deadline(): deadlines, in 64 bit microseconds.
+ * 	- time_interval_start(), time_interval_due(): periodic intervals, without drift.
+ * 	- timer_callback_start(), timer_callback_stop(): one-shot and periodic callbacks, in microseconds.
+ * 	- timer_callback_start_worker(): starts the worker task of deferred callbacks.
  *
  *
  * \note Ensure to initialize the module in the beginning of program.
@@ -59,8 +72,24 @@
  * 			Example: To capture time elapsed between two events, capture time ticks using time_in_microseconds() or
  * 			time_in_milliseconds(); and the difference between two values will provide the required time elapsed value.
  *
- * 		=> Use delay_milliseconds to introduce a delay in milliseconds. Note that this function does not releases
- * 			CPU/microprocessor.
+ * 		=> Use time_in_microseconds_64() to timestamp events, all modules share the same clock for as long as the
+ * 			robot runs. Use time_at_tick() to timestamp events of a task, given by xTaskGetTickCount(), on the same clock.
+ *
+ * 			Example: Wait for a deadline in a task, releasing CPU:
+ * 				deadline = time_deadline_after(20000);
+ * 				vTaskDelay(time_microseconds_to_ticks(time_until_deadline(deadline)));
+ *
+ * 		=> Use delay_milliseconds to introduce a delay in milliseconds. In a task, it releases CPU/microprocessor for
+ * 			whole ticks of the delay, and spins for the remainder shorter than a tick. In an ISR, with interrupts
+ * 			disabled, or before the scheduler is started, it spins for the whole delay.
+ *
+ * 		=> Use timer_callback_start() for a callback at a precise time, or periodic without drift. A callback in ISR
+ * 			context must be short, and may only call ISR safe functions (FromISR in FreeRTOS); a deferred callback is
+ * 			called by the worker task, started once with timer_callback_start_worker().
+ *
+ * 			Example: Toggle a pin every 5ms:
+ * 				static TIMER_CALLBACK toggle_timer;
+ * 				timer_callback_start(&toggle_timer, 5000, 5000, toggle_pin, NULL, TIMER_CALLBACK_IN_ISR);
  *
  *
  */
@@ -78,7 +107,10 @@
  * Note: Avoid nested inclusions.
  */
 
-/* NO INCLUDES */
+#include <stdint.h>
+
+/*FreeRTOS, for TickType_t*/
+#include "FreeRTOS.h"
 
 
 /******************************************************************************************************************/
@@ -95,8 +127,68 @@
  * Note: Avoid initialized data definitions.
  */
 
+#define TIMER_WHEEL_SLOTS												32				/*!<Slots of the timer wheel, a power of 2; a slot for each TIMER0 overflow*/
+#define TIMER_CALLBACK_MINIMUM_PERIOD_IN_MICROSECONDS					100				/*!<Shortest period of a periodic callback, bounds callbacks fired in an ISR*/
+#define TIMER_CALLBACK_WORKER_QUEUE_LENGTH								8				/*!<Deferred callbacks waiting for the worker task*/
+
+
+/*!
+ * \brief Timer callback function.
+ *
+ *
+ * \details Called with the argument given to timer_callback_start().
+ *
+ */
+typedef void (*TIMER_CALLBACK_FUNCTION)(void *argument);
+
+
+/*!
+ * \brief Periodic interval.
+ *
+ *
+ * \details Period and next due time, refer time_interval_start() and time_interval_due().
+ *
+ */
+typedef struct _TIME_INTERVAL {
+	uint64_t period;														/*!<Period in microseconds*/
+	uint64_t next_time;														/*!<Next due time in microseconds*/
+} TIME_INTERVAL;
+
+
+/*!
+ * \brief Timer callback context.
+ *
+ *
+ * \details Context a callback is called in.
+ *
+ */
+typedef enum{
+	TIMER_CALLBACK_IN_ISR											= 0,	/*!<Called in TIMER0 ISR, at the expiry time*/
+	TIMER_CALLBACK_DEFERRED											= 1		/*!<Called by the worker task, after the expiry time*/
+} TIMER_CALLBACK_CONTEXT;
 
-/* NO DEFINITION OF TYPEDEF */
+
+/*!
+ * \brief Timer callback.
+ *
+ *
+ * \details One-shot or periodic callback, on the timer wheel. Owned by the caller, and must stay allocated while
+ * active; static or global variables are zero initialized i.e. inactive. Members are maintained by the module, refer
+ * timer_callback_start().
+ *
+ */
+typedef struct _TIMER_CALLBACK {
+	struct _TIMER_CALLBACK *next;											/*!<Next callback in wheel slot or compare list*/
+	struct _TIMER_CALLBACK *previous;										/*!<Previous callback in wheel slot*/
+	TIMER_CALLBACK_FUNCTION function;										/*!<Function to call*/
+	void *argument;															/*!<Argument of function*/
+	uint32_t expiry_overflow;												/*!<TIMER0 overflow of expiry, lower 32 bits*/
+	uint32_t period_counts;													/*!<Period in TIMER0 counts, 0 for one-shot*/
+	uint32_t rounds;														/*!<Rounds of the wheel left before expiry*/
+	uint8_t expiry_count;													/*!<TIMER0 count of expiry, within the overflow*/
+	uint8_t context;														/*!<Refer TIMER_CALLBACK_CONTEXT*/
+	volatile uint8_t state;													/*!<Inactive, on wheel or in compare list*/
+} TIMER_CALLBACK;
 
 /******************************************************************************************************************/
 /* CODING STANDARDS:
@@ -129,10 +221,39 @@ void initialize_module_timer0(void);
 
 unsigned long time_in_microseconds(void);
 
+uint64_t time_in_microseconds_64(void);
+
 unsigned long time_in_milliseconds(void);
 
 void delay_milliseconds(unsigned long milliseconds);
 
+TickType_t time_microseconds_to_ticks(uint64_t microseconds);
+
+uint64_t time_ticks_to_microseconds(TickType_t ticks);
+
+uint64_t time_at_tick(TickType_t tick);
+
+TickType_t time_tick_at(uint64_t time);
+
+uint64_t time_deadline_after(uint64_t microseconds);
+
+uint8_t time_deadline_expired(uint64_t deadline);
+
+uint64_t time_until_deadline(uint64_t deadline);
+
+void time_interval_start(TIME_INTERVAL *interval, uint64_t period_in_microseconds);
+
+uint8_t time_interval_due(TIME_INTERVAL *interval);
+
+void timer_callback_start(TIMER_CALLBACK *timer, uint32_t delay_in_microseconds, uint32_t period_in_microseconds,
+		TIMER_CALLBACK_FUNCTION function, void *argument, TIMER_CALLBACK_CONTEXT context);
+
+void timer_callback_stop(TIMER_CALLBACK *timer);
+
+uint8_t timer_callback_active(TIMER_CALLBACK *timer);
+
+uint8_t timer_callback_start_worker(UBaseType_t priority, uint16_t stack_depth);
+
 #endif /* INCLUDE_CUSTOM_TIMER_H_ */
 
 /*!@}*/   // end module
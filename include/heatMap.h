@@ -0,0 +1,34 @@
+/*
+ * heatMap.h
+ *
+ */
+
+#ifndef INCLUDE_HEATMAP_H_
+#define INCLUDE_HEATMAP_H_
+
+#include <stdint.h>
+
+#include "include/wireless_interface.h"
+
+// web routes, the page polls the update route
+#define HEAT_MAP_PAGE_ROUTE "/heatmap"
+#define HEAT_MAP_UPDATE_ROUTE "/thermal"
+// poll period of the page in milliseconds, text for the page script; each poll brings a request of several
+// hundred header bytes in at 9600 baud, around half a second of the UART, refer WEB_SERVER_BUDGET_BYTES_IN
+#define HEAT_MAP_POLL_PERIOD "1000"
+
+// thermal values of an update, ambient followed by pixel 1 to 8
+#define HEAT_MAP_VALUES 9
+// longest update, a delta with all values changed
+#define HEAT_MAP_UPDATE_SIZE 72
+
+// update, comma separated text
+// keyframe  K<sequence>,<servo position>,<value 0>,...,<value 8>
+// delta     D<sequence>,<servo position>[,<index>:<value>]...  only values changed since the previous update
+// the client sends back the sequence of the last update it received as ?s=<sequence>, a delta is sent only if
+// it is the sequence of the previous update, otherwise a keyframe
+int encodeHeatMapUpdate(char *buffer, long clientSequence, const uint8_t *values, uint16_t servoPosition);
+void serveHeatMapPage(TCP_SOCKET socket, char *query);
+void serveHeatMapUpdate(TCP_SOCKET socket, char *query);
+
+#endif /* INCLUDE_HEATMAP_H_ */
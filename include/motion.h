@@ -29,6 +29,7 @@ void     motion_servo_start          (int deviceId);
 void     motion_servo_stop           (int deviceId);
 
 int      motion_enc_read(int deviceId, uint32_t* tickCount);
+uint16_t motion_enc_count(int deviceId);
 
 
 
@@ -0,0 +1,43 @@
+/*
+ * motionScript.h
+ *
+ */
+
+#ifndef INCLUDE_MOTIONSCRIPT_H_
+#define INCLUDE_MOTIONSCRIPT_H_
+
+#include <stdint.h>
+
+// largest number of steps in a script
+#define MOTION_SCRIPT_STEPS 16
+// bytes of a compiled step: move character and behavior cycles
+#define MOTION_SCRIPT_STEP_SIZE 2
+
+// behavior cycles of a step without argument, same as the web page commands; S stops for one cycle
+#define MOTION_SCRIPT_MOVE_CYCLES 6
+#define MOTION_SCRIPT_SPIN_CYCLES 1
+#define MOTION_SCRIPT_STOP_CYCLES 1
+
+// a script is comma separated steps, each step a console move: F, B [cm], L, R [degrees] or S,
+// for example F50,L90,F30,R45,S
+typedef struct {
+	uint8_t code[MOTION_SCRIPT_STEPS * MOTION_SCRIPT_STEP_SIZE];
+	uint8_t steps;
+} MotionScript;
+
+// sent by the executor when a step is completed, last is 1 for the last step of the script
+typedef struct {
+	uint16_t id;
+	uint8_t step;
+	char move;
+	uint8_t last;
+} MotionScriptEvent;
+
+int compileMotionScript(const char *text, MotionScript *script);
+void initMotionScript(void);
+uint16_t loadMotionScript(const MotionScript *script);
+int runMotionScript(void);
+int getMotionScriptEvent(MotionScriptEvent *event);
+void getMotionScriptStatus(uint16_t *id, int *step, int *steps);
+
+#endif /* INCLUDE_MOTIONSCRIPT_H_ */
@@ -0,0 +1,23 @@
+/*
+ * rangeMap.h
+ *
+ */
+
+#ifndef INCLUDE_RANGEMAP_H_
+#define INCLUDE_RANGEMAP_H_
+
+#include <stdint.h>
+
+// bins of the polar map, each covers 360 / RANGE_MAP_BINS degrees of heading
+#define RANGE_MAP_BINS 24
+// age in milliseconds after which a bin is unknown
+#define RANGE_MAP_MAX_AGE 5000UL
+// distance in cm of a bin without obstacle, beyond the range of the sonar
+#define RANGE_MAP_FREE_DISTANCE 400
+
+void updateRangeMap(double heading, int valid, double distance);
+int getRangeMapBin(int bin, uint16_t *distance, uint32_t *age);
+int getNearestObstacle(double *distance, double *bearing);
+int getFreeDirection(double minDistance, double *bearing);
+
+#endif /* INCLUDE_RANGEMAP_H_ */
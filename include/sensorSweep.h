@@ -0,0 +1,42 @@
+/*
+ * sensorSweep.h
+ *
+ */
+
+#ifndef INCLUDE_SENSORSWEEP_H_
+#define INCLUDE_SENSORSWEEP_H_
+
+#include <stdint.h>
+
+// servo positions of the sweep, in pulse width ticks
+#define SENSOR_SWEEP_MIN 1140
+#define SENSOR_SWEEP_MAX 4140
+// step of the coarse sweep, about 15 degrees
+#define SENSOR_SWEEP_COARSE_STEP 300
+// first step of the fine sweep around the target, widened by this much on each step without heat
+#define SENSOR_SWEEP_FINE_STEP 100
+// steps without heat after which the target is lost and the coarse sweep resumes
+#define SENSOR_SWEEP_LOST_STEPS 6
+// confidence of the heat bearing that acquires a target, refer getHeatBearing
+#define SENSOR_SWEEP_ACQUIRE_CONFIDENCE 25
+// a target closer to the sensor axis than this, in ticks, is held without moving, about 5 degrees
+#define SENSOR_SWEEP_DEADBAND 100
+
+// sweep modes
+#define SENSOR_SWEEP_COARSE 0
+#define SENSOR_SWEEP_TRACK 1
+
+typedef struct {
+	uint8_t mode;
+	uint16_t position;
+	// direction of the coarse sweep, 1 toward SENSOR_SWEEP_MAX, -1 toward SENSOR_SWEEP_MIN
+	int8_t direction;
+	// servo position looking at the target, and steps since it was seen
+	uint16_t target;
+	uint8_t lost;
+} SensorSweep;
+
+void initSensorSweep(SensorSweep *sweep, uint16_t position);
+uint16_t stepSensorSweep(SensorSweep *sweep, int coarse, int confidence, double bearing);
+
+#endif /* INCLUDE_SENSORSWEEP_H_ */
@@ -8,7 +8,53 @@
 #ifndef INCLUDE_SONAR_H_
 #define INCLUDE_SONAR_H_
 
+#include <stdint.h>
+
+// default measurement periods, faster while the wheels move, and timeout from the trigger to the end of the echo;
+// the PING))) echo is at most about 18.5 ms, after a hold-off of 750 us
+#define SONAR_MOVING_PERIOD_IN_MICROSECONDS 30000UL
+#define SONAR_IDLE_PERIOD_IN_MICROSECONDS 120000UL
+#define SONAR_TIMEOUT_IN_MICROSECONDS 25000UL
+#define SONAR_HOLD_OFF_IN_MICROSECONDS 1000UL
+
+// measurements filtered together, refer getSonarRange()
+#define SONAR_HISTORY 5
+
+// status of a reading
+#define SONAR_NO_READING 0
+#define SONAR_ECHO 1
+#define SONAR_NO_ECHO 2
+
+// distance of a reading without echo, beyond the range of the sensor
+#define SONAR_NO_ECHO_DISTANCE 400.0
+
+typedef struct {
+	double distance;
+	// start of the echo, or the timeout, on the 64 bit clock of custom_timer
+	uint64_t time;
+	// counts measurements, so a reader can tell a new one
+	uint16_t sequence;
+	uint8_t status;
+} SonarReading;
+
+// filtered range, refer getSonarRange()
+typedef struct {
+	double distance;
+	// cm/s, negative when the target gets closer
+	double rate;
+	// time of the latest measurement, on the 64 bit clock of custom_timer
+	uint64_t time;
+	uint8_t valid;
+} SonarRange;
+
 void initSonar(void);
+void setSonarTimeout(uint32_t microseconds);
+void setSonarRate(uint32_t movingPeriod, uint32_t idlePeriod);
+int processSonarMeasurement(void);
+int getSonarReading(SonarReading *reading);
+int getSonarRange(SonarRange *range);
+uint32_t filterSonarEcho(const uint32_t *history, int count, uint32_t latest);
 double getSonarDistance(void);
+uint64_t getSonarTime(void);
 
 #endif /* INCLUDE_SONAR_H_ */
@@ -0,0 +1,56 @@
+/*
+ * telemetry.h
+ *
+ */
+
+#ifndef INCLUDE_TELEMETRY_H_
+#define INCLUDE_TELEMETRY_H_
+
+#include <stdint.h>
+
+// frame layout, all values little-endian and fixed-point
+// 0  sync              uint8, TELEMETRY_SYNC
+// 1  version           uint8, TELEMETRY_VERSION; decoders skip frames of unknown version
+// 2  type              uint8, TELEMETRY_TYPE_...
+// 3  length            uint8, payload bytes
+// 4  robot id          uint16
+// 6  sequence number   uint16, increments by 1 for each frame of a stream, a collector detects gaps from it
+// 8  time              uint32, milliseconds since start
+// 12 payload           length bytes
+// 12 + length  CRC-16  uint16, CRC-16/XMODEM (polynomial 0x1021, initial 0) of version up to end of payload
+//
+// payload of TELEMETRY_TYPE_SAMPLE
+// 0  distance          uint16, cm
+// 2  speed             uint16, mm/s
+// 4  sonar distance    uint16, mm
+// 6  command           uint8, 0 stop, 1 attachment, 2 forward, 3 backward, 4 left, 5 right, 6 motion script
+// 7  state             uint8, attachment state: 0 searching, 1 attached, 2 panic
+// 8  thermal frame     9 x uint8, ambient followed by pixel 1 to 8, degree C
+#define TELEMETRY_SYNC 0xA5
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_TYPE_SAMPLE 1
+#define TELEMETRY_HEADER_SIZE 12
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_THERMAL_PIXELS 9
+#define TELEMETRY_SAMPLE_SIZE (8 + TELEMETRY_THERMAL_PIXELS)
+#define TELEMETRY_FRAME_SIZE (TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_SIZE + TELEMETRY_CRC_SIZE)
+
+// sends after a failed connection wait this many calls before trying again
+#define TELEMETRY_RETRY_CALLS 30
+
+typedef struct {
+	double distance;	// m
+	double speed;		// m/s
+	double sonar;		// cm
+	uint8_t command;
+	uint8_t state;
+	uint8_t thermal[TELEMETRY_THERMAL_PIXELS];
+} TelemetrySample;
+
+void initTelemetry(uint16_t robotId, char *collectorAddress, uint16_t collectorPort);
+int buildTelemetryFrame(uint8_t *frame, uint16_t robotId, uint16_t sequence, uint32_t time, const TelemetrySample *sample);
+int checkTelemetryFrame(const uint8_t *frame, int length);
+int encodeTelemetryFrame(uint8_t *frame, const TelemetrySample *sample);
+void sendTelemetry(const TelemetrySample *sample);
+
+#endif /* INCLUDE_TELEMETRY_H_ */
@@ -0,0 +1,25 @@
+/*
+ * thermalPanorama.h
+ *
+ */
+
+#ifndef INCLUDE_THERMALPANORAMA_H_
+#define INCLUDE_THERMALPANORAMA_H_
+
+#include <stdint.h>
+
+#include "include/thermalSensor.h"
+
+// bins of the panorama, each covers THERMAL_PANORAMA_DEGREES / THERMAL_PANORAMA_BINS degrees of bearing,
+// about the width of a pixel
+#define THERMAL_PANORAMA_BINS 36
+// field of the panorama, centered on the robot front; the servo sweep and the field of view cover about 186 degrees
+#define THERMAL_PANORAMA_DEGREES 180.0
+// age in milliseconds after which a bin is unknown, a sweep from end to end takes around 3 seconds
+#define THERMAL_PANORAMA_MAX_AGE 5000UL
+
+void updateThermalPanorama(const ThermalFrame *frame);
+int getThermalPanoramaBin(int bin, uint8_t *temperature, uint32_t *age);
+int getHottestDirection(double *bearing, uint8_t *temperature);
+
+#endif /* INCLUDE_THERMALPANORAMA_H_ */
@@ -8,13 +8,61 @@
 #ifndef INCLUDE_THERMALSENSOR_H_
 #define INCLUDE_THERMALSENSOR_H_
 
+#include <stdint.h>
+
+// ambient and 8 pixels
+#define THERMAL_VALUES 9
+#define THERMAL_PIXELS 8
+// acquisition period of the thermal task
+#define THERMAL_FRAME_PERIOD 50
+// degrees above the background of a foreground pixel
+#define THERMAL_FOREGROUND_DELTA 2
+
+// TPA81 field of view is 41 degrees over the 8 pixels, pixel 1 on the right
+#define THERMAL_PIXEL_DEGREES (41.0 / THERMAL_PIXELS)
+// servo sweeps about 180 degrees from MIN_PULSE_WIDTH_TICKS to MAX_PULSE_WIDTH_TICKS, turning right as the pulse
+// width grows; INITIAL_PULSE_WIDTH_TICKS looks straight ahead
+#define THERMAL_SERVO_DEGREES_PER_TICK (180.0 / (4800 - 1100))
+// degrees above ambient of a pixel that weighs in the heat bearing, same as closeToHeat
+#define THERMAL_BEARING_DELTA 1
+// summed degrees above THERMAL_BEARING_DELTA of a heat bearing with full confidence
+#define THERMAL_BEARING_FULL_HEAT 16
+
+typedef struct {
+	// ambient, then pixels 1 to 8
+	uint8_t values[THERMAL_VALUES];
+	// capture time in milliseconds
+	unsigned long time;
+	// servo pulse width at capture, the direction the pixels were looking at
+	uint16_t servoPosition;
+	uint16_t sequence;
+	// computed once per frame, refer filterThermalFrame
+	uint8_t average;
+	uint8_t left;
+	uint8_t right;
+	uint8_t center;
+	// servo stepped or wheels turned since the last frame
+	uint8_t viewMoving;
+	// bit 0 for pixel 1 to bit 7 for pixel 8
+	uint8_t foreground;
+	uint16_t motion;
+	// heat bearing from the robot front in tenths of degrees, positive to the left, refer estimateHeatBearing
+	int16_t bearing;
+	// 0 to 100, 0 when no pixel is warm
+	uint8_t confidence;
+} ThermalFrame;
+
 void initThermal(void);
-void readTemperatures(void);
+int acquireThermalFrame(void);
+int getThermalFrame(ThermalFrame *frame);
 int getTemperatureAvg(void);
 int getSensorValue(int sensor);
+uint16_t getThermalServoPosition(void);
 int getLeftAvg(void);
 int getRightAvg(void);
 int getCenterAvg(void);
+uint8_t getThermalForeground(uint16_t *motion);
+int getHeatBearing(double *bearing);
 int closeToHeat(void);
 
 #endif /* INCLUDE_THERMALSENSOR_H_ */
@@ -8,8 +8,11 @@
 #ifndef INCLUDE_WHEELCONTROL_H_
 #define INCLUDE_WHEELCONTROL_H_
 
+#include <stdint.h>
+
 void initMotion();
 void spinSensor();
+void updateSensorSweep(void);
 void moveForward();
 void moveBackward();
 void spinLeft();
@@ -18,5 +21,10 @@ void stopMotion();
 void updateTimeDistance();
 double getAvgSpeed();
 double getDistance();
+uint64_t getWheelEventTime(int wheel);
+int getMovingDirection(void);
+double getHeading(void);
+void brakeForCollision(int valid, double distance, double rate);
+int getCollisionBrake(uint16_t *count);
 
 #endif /* INCLUDE_WHEELCONTROL_H_ */
@@ -65,6 +65,28 @@
  *
  * \warning Ensure to define an unique SSID, to avoid conflict with neighbouring networks.
  *
+ * \note With SET_GAINSPAN_CHANNEL_SCAN_ON set to 1, the module scans for neighbouring networks before starting
+ * the Limited AP and starts it on the least congested channel; this adds approximately 3s to the initialization.
+ *
+ * \note Driver statistics (bytes, frames, parse errors, accepts, resets, per-command timeouts, and histograms of
+ * page-serve and command round-trip time) are collected at all times; read them with gs_get_statistics(), send
+ * them to serial terminal with gs_send_statistics_to_serial_terminal(), or over HTTP at /stats.
+ *
+ * \note Web server admission control: a request is served only if the requests, bytes received, bytes sent and serve time of the
+ * current WEB_SERVER_BUDGET_WINDOW_IN_MILLISECONDS window are within the budget, and a web-page submission only if the
+ * client response buffer has room; otherwise it is answered with "503 Service Unavailable", which is fast. Call
+ * process_client_request() from a task with priority lower than motor and sensor tasks.
+ *
+ * \note Web-page choices are sent to /cmd?c=X by a script on the page, which stores the client response and answers
+ * with a short acknowledgement, example {"id":12}, instead of sending the web-page again. Paths other than "/" and
+ * the routes are answered with "404 Not Found".
+ *
+ * \note With SET_WEB_SERVER_MODULE_BACKEND_ON set to 1, the Gainspan on-module web server (AT+WEBSERVER, with
+ * AT+XMLPARSE) handles HTTP framing and serves the web-page from module file system; requests to
+ * WEB_SERVER_MODULE_URI reach the MCU as parsed parameters, and routes reply with compact values only. To compare
+ * the backends, build each, serve the same requests, and compare bytes in/out per request and page-serve histogram
+ * reported by the driver statistics.
+ *
  * Usage guide (For "Limited AP" or hot-spot mode):
  *
  * 		=> Set SET_GAINSPAN_TERMINAL_OUTPUT_ON to 1 in "gainspan_gs1011m.h" to get the command response/progress on
@@ -105,6 +127,13 @@
  *
  *				add_element_choice('R', "Reverse");
  *
+ * 		=> Optionally, serve additional pages by adding routes, before starting the web server. The handler
+ * 			writes the complete HTTP response to the socket.
+ *
+ * 			call add_web_route(char *route_path, WEB_ROUTE_HANDLER route_handler)
+ *
+ * 			Example: add_web_route("/status", serve_status_page);
+ *
  * 		=> Start web server - with http port 80 and TCP protocol
  *
  * 			call start_web_server();
@@ -164,6 +193,10 @@
 /*Send commands and respective command response to terminal*/
 #define SET_GAINSPAN_TERMINAL_OUTPUT_ON					1				/*!Default - 0; set to 1 to send the commands and respective response from Gainspan device to serial terminal define in Gainspan data structure gainspan.serial_terminal_usart_id*/
 #define SET_WEB_SERVER_TERMINAL_OUTPUT_ON				1				/*!Default - 0; set to 1 to send the commands and respective response from Gainspan device to serial terminal define in Gainspan data structure gainspan.serial_terminal_usart_id*/
+/*Scan neighbouring networks and select the least congested channel for Limited AP*/
+#define SET_GAINSPAN_CHANNEL_SCAN_ON					1				/*!Default - 1; set to 0 to start Limited AP on the configured channel (gainspan.wireless_channel) without scanning*/
+/*Web server backend*/
+#define SET_WEB_SERVER_MODULE_BACKEND_ON				0				/*!Default - 0; set to 1 to let the Gainspan on-module web server handle HTTP, only parsed request parameters and compact responses cross the USART*/
 
 /*Serial2WiFi: AT commands*/
 
@@ -177,7 +210,7 @@
 #define AT_GET_DEVICE_SOFTWARE_VERSION					6				/*!<Get software version.  *Not implemented*/
 /*WiFi interface configuration*/
 #define AT_GET_DEVICE_MAC_ADDRESS						7				/*!<Get MAC address of device. *Not implemented*/
-#define AT_SCAN_NETWORK_FOR_SSID						8				/*!<Scan WiFi networks for SSID. *Not implemented*/
+#define AT_SCAN_NETWORK_FOR_SSID						8				/*!<Scan WiFi networks; implemented without SSID i.e. scans all channels for all networks.*/
 #define AT_SET_WIRELESS_MODE							9				/*!<Set wireless mode: 0-Infrastructure, 1-Ad Hoc, 2-limited AP.*/
 #define AT_ASSOCIATE_START_NETWORK						10				/*!<Associate with a Network, or Start an Ad Hoc or Infrastructure (AP) Network. Parameters-SSID,BSSID,Ch,Rssi Flag.*/
 #define AT_DISASSOCIATE_CURRENT_NETWORK					11				/*!<Disassociate from current network.*/
@@ -213,7 +246,7 @@
 #define AT_START_TCP_SERVER								37				/*!<Start the TCP server connection with IPv4 address; parameters: Port,max client connection (1-15).*/
 #define AT_START_TCP_CLIENT								38				/*!<Create a TCP client connection to the remote server with IPv4; parameters: Dest-Address,Port. *Not implemented*/
 #define AT_START_UDP_SERVER								39				/*!<Start the UDP server connection with IPv4 address; parameters: Port. *Not implemented*/
-#define AT_START_UDP_CLIENT								40				/*!<Create a UDP client connection to the remote server with IPv4; parameters: Dest-Address,Port,Src.Port. *Not implemented*/
+#define AT_START_UDP_CLIENT								40				/*!<Create a UDP client connection to the remote server with IPv4; parameters: Dest-Address,Port; implemented without Src.Port.*/
 #define AT_CLOSE_CONNECTION_CID							41				/*!<Close the connection associated with current active socket by identifying CID:CID.*/
 /*Provisioning*/
 #define AT_START_WEB_PROVISIONING						44				/*!<Start support provisioning through web pages:user name , password ,[SSL Enabled,Param StoreOption,idletimeout,ncmautoconnect].  *Not implemented*/
@@ -240,6 +273,35 @@
 #define SERVER_PROTOCOL									PROTOCOL_TCP	/*!Default - protocol - PROTOCOL_TCP*/
 #define RING_BUFFER_SIZE 								10				/*!Ring buffer size, no of characters*/
 
+/*Channel scan*/
+#define WIRELESS_CHANNEL_COUNT							11				/*!<Number of valid 2.4 GHz channels, refer WIRELESS_CHANNEL*/
+#define WIRELESS_CHANNEL_OVERLAP						4				/*!<Channels closer than (WIRELESS_CHANNEL_OVERLAP + 1) apart interfere with each other*/
+#define WIRELESS_RSSI_FLOOR								-100			/*!<RSSI floor in dBm; strength of a neighbour is its RSSI above this floor*/
+#define WIRELESS_NEIGHBOUR_PENALTY						10				/*!<Score added for each neighbour, regardless of its RSSI*/
+#define CHANNEL_SCAN_POLLING_PERIOD_IN_MILLISECONDS		5000			/*!<Time allowed for the module to complete the scan of all channels*/
+
+/*Driver statistics*/
+#define AT_COMMAND_COUNT								46				/*!<Number of command identifiers i.e. highest AT command identifier + 1*/
+#define STATISTICS_HISTOGRAM_BUCKETS					8				/*!<Number of buckets in time histograms, last bucket holds all the times above the previous bucket*/
+
+/*Web server routes*/
+#define WEB_ROUTES										8				/*!<Maximum number of web server routes, including the /stats and /cmd routes*/
+
+/*Web server admission control: resources the web server may use in a window; requests beyond are answered with 503*/
+#define WEB_SERVER_BUDGET_WINDOW_IN_MILLISECONDS		30000			/*!<Budget window*/
+#define WEB_SERVER_BUDGET_REQUESTS						100				/*!<Requests served in a window, allows polling with short responses*/
+#define WEB_SERVER_BUDGET_BYTES_OUT						6000			/*!<Bytes sent to Gainspan in a window, approximately 20% of USART at 9600 baud*/
+#define WEB_SERVER_BUDGET_BYTES_IN						15000			/*!<Bytes received from Gainspan in a window, approximately 50% of USART at 9600 baud; a browser request brings several hundred header bytes*/
+#define WEB_SERVER_BUDGET_SERVE_TIME_IN_MILLISECONDS	15000			/*!<Time serving requests in a window, half of it*/
+
+/*On-module web server backend*/
+#define WEB_SERVER_MODULE_URI							"/gainspan/profile/mcu"	/*!<URI prefix the on-module web server forwards to the MCU, routes follow the prefix*/
+#define WEB_SERVER_MODULE_FRAME_HEADER_SIZE				7				/*!<Frame header: Escape, 'K', CID, 4 digit data length*/
+#define WEB_SERVER_MODULE_FRAME_DATA_SIZE				9999			/*!<Maximum data length of a frame, limited by 4 digit data length*/
+
+/*UDP client*/
+#define UDP_CLIENT_POLLING_PERIOD_IN_MILLISECONDS		500				/*!<Time allowed for the module to create UDP client connection*/
+
 /*!
  * \brief HTML elements
  *
@@ -492,6 +554,59 @@ typedef enum {
 } WIRELESS_CHANNEL;
 
 
+/*Channel scan result*/
+/*!
+ * \brief Channel scan result.
+ *
+ *
+ * \details Neighbouring networks found on each channel, and sum of their strengths (RSSI above WIRELESS_RSSI_FLOOR).
+ * Arrays are indexed by channel number i.e. index 0 is unused.
+ *
+ */
+typedef struct _CHANNEL_SCAN_RESULT {
+	uint8_t neighbour_count[WIRELESS_CHANNEL_COUNT + 1];					/*!<Number of neighbouring networks on the channel*/
+	uint16_t neighbour_strength[WIRELESS_CHANNEL_COUNT + 1];				/*!<Sum of strengths of neighbouring networks on the channel*/
+	uint8_t networks_found;													/*!<Total number of neighbouring networks parsed from scan*/
+} CHANNEL_SCAN_RESULT;
+
+
+/*Driver statistics*/
+/*!
+ * \brief Driver statistics.
+ *
+ *
+ * \details Counters and time histograms for interface with Gainspan WiFi module, and web server. Histogram bucket
+ * upper limits (in milliseconds) are listed in gs_format_statistics() output.
+ *
+ */
+typedef struct _GAINSPAN_STATISTICS {
+	uint32_t bytes_in;														/*!<Bytes received from Gainspan*/
+	uint32_t bytes_out;														/*!<Bytes sent to Gainspan*/
+	uint32_t bytes_dropped;													/*!<Bytes received from Gainspan and discarded by gs_flush()*/
+	uint16_t frames_parsed;													/*!<TCP data frames (escape sequence with CID) received*/
+	uint16_t parse_errors;													/*!<Responses with ERROR, INVALID CID, or no recognized outcome*/
+	uint16_t accepts;														/*!<Client connections accepted*/
+	uint16_t resets;														/*!<Socket resets*/
+	uint16_t pages_served;													/*!<HTTP responses served*/
+	uint16_t requests_rejected;												/*!<Requests answered with 503, web server budget exhausted or client response buffer full*/
+	uint16_t command_timeouts[AT_COMMAND_COUNT];							/*!<Commands without response within polling period, indexed by AT command*/
+	uint16_t page_serve_time_histogram[STATISTICS_HISTOGRAM_BUCKETS];		/*!<Time from connection established to socket reset*/
+	uint16_t command_round_trip_time_histogram[STATISTICS_HISTOGRAM_BUCKETS];	/*!<Time from command sent to first character of response*/
+} GAINSPAN_STATISTICS;
+
+
+/*Web server route handler*/
+/*!
+ * \brief Web server route handler.
+ *
+ *
+ * \details Function serving a route; writes the complete HTTP response to the socket. query points to the
+ * characters after '?' in the request (empty if none), and is not terminated at the end of query.
+ *
+ */
+typedef void (*WEB_ROUTE_HANDLER)(TCP_SOCKET socket, char *query);
+
+
 /*Wireless security configuration*/
 /*!
  * \brief Wireless security configuration.
@@ -632,6 +747,18 @@ void gs_set_webserver_authentication(WEBSERVER_AUTHENTICATION_PROFILE target_web
 
 GAINSPAN_ACTIVE gs_activate_wireless_connection(void);
 
+WIRELESS_CHANNEL gs_scan_for_least_congested_channel(void);
+
+void gs_clear_channel_scan_result(CHANNEL_SCAN_RESULT *scan_result);
+
+uint8_t gs_append_channel_scan_character(char *scan_line, uint16_t *scan_line_index, char character);
+
+SUCCESS_ERROR gs_parse_channel_scan_line(char *scan_line, CHANNEL_SCAN_RESULT *scan_result);
+
+uint32_t gs_get_channel_score(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL channel);
+
+WIRELESS_CHANNEL gs_select_least_congested_channel(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL default_channel);
+
 SOCKET_STATUS gs_get_socket_status(TCP_SOCKET socket);
 
 SUCCESS_ERROR gs_activate_socket(TCP_SOCKET socket);
@@ -652,6 +779,10 @@ SUCCESS_ERROR gs_reset_socket(TCP_SOCKET socket);
 
 SUCCESS_ERROR gs_disconnect_deactivate_socket(TCP_SOCKET socket);
 
+SUCCESS_ERROR gs_open_udp_client(TCP_SOCKET socket, char *destination_address, TCP_PORT destination_port);
+
+void gs_write_binary_data_to_socket(TCP_SOCKET socket, uint8_t *data, uint16_t data_length);
+
 SUCCESS_ERROR gs_read_data_from_socket(char *data_string);
 
 TCP_SOCKET gs_get_socket_having_active_connection_and_data(void);
@@ -664,12 +795,28 @@ void gs_write_complete_to_socket(TCP_SOCKET socket);
 
 void gs_flush(void);
 
+void gs_get_statistics(GAINSPAN_STATISTICS *statistics);
+
+void gs_clear_statistics(void);
+
+uint8_t gs_format_statistics(char *string_buffer, uint8_t line_number);
+
+void gs_send_statistics_to_serial_terminal(void);
+
 /*Web server APIs*/
 
 void configure_web_page(char *page_title, char *menu_title, HTML_ELEMENT_TYPE element_type);
 
 void add_element_choice(char choice_identifier, char *element_label);
 
+void add_web_route(char *route_path, WEB_ROUTE_HANDLER route_handler);
+
+void send_http_response_header(TCP_SOCKET socket, char *status, char *content_type);
+
+void send_http_response_data(TCP_SOCKET socket, char *data_string);
+
+void send_http_response(TCP_SOCKET socket, char *status, char *content_type, char *data_string);
+
 void start_web_server(void);
 
 void process_client_request(void);
@@ -11,7 +11,7 @@
  * \date 02/05/2017
  *
  * Main module for Chico, handles the task scheduler, led display,
- * lcd lights, and thermal sensor
+ * lcd lights, thermal sensor, and serial console
  -----------------------------------------------------------------*/
 
 /* --Includes-- */
@@ -40,6 +40,21 @@
 #include "include/thermalSensor.h"
 #include "include/wheelControl.h"
 #include "include/sonar.h"
+#include "include/console.h"
+#include "include/telemetry.h"
+#include "include/heatMap.h"
+#include "include/motionScript.h"
+#include "include/cpuStats.h"
+#include "include/rangeMap.h"
+#include "include/thermalPanorama.h"
+
+// distance in cm of a free direction, same as the attachment mode checks
+#define FREE_DIRECTION_DISTANCE 40
+
+// telemetry collector, each robot needs its own id
+#define ROBOT_ID 1
+#define TELEMETRY_COLLECTOR_ADDRESS "192.168.3.2"
+#define TELEMETRY_COLLECTOR_PORT 5005
 
 USART_ID usart_zero = USART0_ID;							/*!<USART for serial terminal communication.*/
 USART_ID usart_one = USART1_ID;								/*!<USART for LCD communication.*/
@@ -49,18 +64,43 @@ USART_ID usart_two = USART2_ID;								/*!<USART for Gainspan WiFi communication
 
 /* --Prototypes-- */
 int main(void) __attribute__((OS_main));
+void startWiFi(void);
 void taskHandleHttp(void *pvParameters);
 void taskSpeedMonitor(void *pvParameters);
 void taskBehavior(void *pvParameters);
+void taskSonar(void *pvParameters);
+void taskThermal(void *pvParameters);
 void taskLCD(void *pvParameters);
+void taskConsole(void *pvParameters);
+int setCommand(char request, int cycles);
+int startScript(const char *text, int *steps);
+void executeConsoleCommand(ConsoleCommand *consoleCommand);
+void getTelemetrySample(TelemetrySample *sample);
+void serveTelemetry(TCP_SOCKET socket, char *query);
+void serveScript(TCP_SOCKET socket, char *query);
+void serveCpuStats(TCP_SOCKET socket, char *query);
+void printCpuStats(void);
 void vApplicationStackOverflowHook( TaskHandle_t xTask, portCHAR *pcTaskName);
 
 int usartfd;
 
 double dis = 0;
 int closeHeat = 0;
+// bearing of the heat in degrees from the robot front, positive to the left
+double heatBearing = 0;
 int moveCount = 0;
 int command = 0;
+// behavior cycles of the current move command
+int moveCycles = 0;
+
+// commands for behavior task, from the web page, console and scripts; command, moveCount and moveCycles
+// are only written by behavior task
+typedef struct {
+	int command;
+	int cycles;
+} BehaviorCommand;
+#define COMMAND_QUEUE_LENGTH 4
+QueueHandle_t commandQueue;
 
 int state = 0;
 // state: 0 searching, 1 attached, 2 panic
@@ -70,6 +110,9 @@ int state = 0;
  *
  *\details Initializes serial port and hardware components, and enables interrupts in order to set up the task scheduler
  *\details Priority is given to the LCD before the thermal sensor.
+ *\details WiFi is started by the HTTP task, which takes several seconds, so the other tasks run right after power-on.
+ *\details Stack sizes are in bytes; console C and web route /cpu report the stack each task has left at its high
+ * water mark, check it after changing a task.
  *
  *
  */
@@ -88,34 +131,22 @@ int main(void)
 	taskENABLE_INTERRUPTS();
 	portENABLE_INTERRUPTS();
 
-	gs_initialize_module(usart_two, BAUD_RATE_9600, usart_zero, BAUD_RATE_115200);
-	gs_set_wireless_ssid("HP-Print-900-LaserCat");
-	gs_activate_wireless_connection();
-
-	configure_web_page("Chico", "Chico Control", HTML_DROPDOWN_LIST);
-
-	add_element_choice('A', "Attach"); // Attach
-	add_element_choice('S', "Stop"); // Stop
-	add_element_choice('F', "Forward"); // Up arrow, forward
-	add_element_choice('B', "Backward"); // Down, backward
-	add_element_choice('L', "Left"); // Counter clockwise, spin left
-	add_element_choice('R', "Right"); // Clockwise, spin right
-
-	start_web_server();
-	_delay_ms(3000);
-
 	// enable hardware components
 	initLCD();
 	initLED();
-	initMotion();
+	// custom timer, started by sonar, marks the sensor steps of motion
 	initSonar();
+	initMotion();
+	initMotionScript();
+
+	commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(BehaviorCommand));
 
 	xTaskCreate(
 		taskHandleHttp,
 		(const portCHAR *)"SRPRWFRQ",
-		1024,
+		1024,	// starts WiFi first, the Gainspan driver and web server buffers
 		NULL,
-		3,
+		2,	// below motor and sensor tasks, so web requests and the WiFi start cannot delay them
 		NULL);
 
 	xTaskCreate(
@@ -134,10 +165,34 @@ int main(void)
 		3,
 		NULL);
 
+	xTaskCreate(
+		taskSonar,
+		(const portCHAR *)"Sonar",
+		192,	// soft float of the filter, collision brake and range map
+		NULL,
+		3,
+		NULL);
+
+	xTaskCreate(
+		taskThermal,
+		(const portCHAR *)"Thermal",
+		192,	// soft float of the bearing and panorama
+		NULL,
+		3,
+		NULL);
+
 	xTaskCreate(
 		taskLCD,
 		(const portCHAR *)"LCD",
-		160,
+		192,	// CPU statistics are updated by this task
+		NULL,
+		3,
+		NULL);
+
+	xTaskCreate(
+		taskConsole,
+		(const portCHAR *)"Console",
+		384,
 		NULL,
 		3,
 		NULL);
@@ -165,25 +220,249 @@ void serve_client_request(void)
 	/*serve each request, if there*/
 	for (buffer_read_counter = 0; buffer_read_counter  < RING_BUFFER_SIZE; buffer_read_counter ++){
 		client_request = get_next_client_response();
-		if (client_request == 'S'){
-			command = 0;
-		}
-		else if (client_request == 'A'){
-			command = 1;
-		}
-		else if (client_request == 'F'){
-			command = 2;
-		}
-		else if (client_request == 'B'){
-			command = 3;
-		}
-		else if (client_request == 'L'){
-			command = 4;
+		setCommand(client_request, 0);
+	}
+}
+
+
+/*! \brief Set the command
+ *
+ * \details Send the command of behavior task from a web page or console request, it is taken at the start of
+ * the next behavior cycle. Forward and backward run for 6 behavior cycles, spins for 1 cycle, unless cycles is given.
+ *
+ * @param request Command character: S, A, F, B, L or R; other characters are ignored
+ * @param cycles Behavior cycles of a move, 0 for the default
+ * @return Behavior cycles of the move, -1 if the request is ignored or the command queue is full
+ *
+ */
+int setCommand(char request, int cycles)
+{
+	BehaviorCommand next;
+
+	next.cycles = 0;
+	if (request == 'S'){
+		next.command = 0;
+	}
+	else if (request == 'A'){
+		next.command = 1;
+	}
+	else if (request == 'F'){
+		next.command = 2;
+		next.cycles = (cycles > 0) ? cycles : 6;
+	}
+	else if (request == 'B'){
+		next.command = 3;
+		next.cycles = (cycles > 0) ? cycles : 6;
+	}
+	else if (request == 'L'){
+		next.command = 4;
+		next.cycles = (cycles > 0) ? cycles : 1;
+	}
+	else if (request == 'R'){
+		next.command = 5;
+		next.cycles = (cycles > 0) ? cycles : 1;
+	}
+	else {
+		return -1;
+	}
+	if (xQueueSend(commandQueue, &next, 0) != pdTRUE) {
+		return -1;
+	}
+	return next.cycles;
+}
+
+
+/*! \brief Start a motion script
+ *
+ * \details Compile a motion script and send it as the command of behavior task, replacing the current command.
+ * The behavior task runs the steps back to back. The script is loaded only once the command is queued, with the
+ * scheduler suspended, so a full queue leaves the running script alone, and behavior task cannot take the command
+ * before its script is loaded.
+ *
+ * @param text Motion script, refer motionScript.h
+ * @param steps Set to the number of steps
+ * @return Id of the script, -1 if the script is not accepted or the command queue is full
+ *
+ */
+int startScript(const char *text, int *steps)
+{
+	MotionScript script;
+	BehaviorCommand next = {6, 0};
+	int id = -1;
+
+	*steps = compileMotionScript(text, &script);
+	if (*steps < 0) {
+		return -1;
+	}
+	vTaskSuspendAll();
+	if (xQueueSend(commandQueue, &next, 0) == pdTRUE) {
+		id = loadMotionScript(&script);
+	}
+	xTaskResumeAll();
+	return id;
+}
+
+
+/*! \brief Get telemetry sample
+ *
+ * \details Collect the latest sensor and control state, as read by behavior task.
+ *
+ * @param sample Sample to fill
+ *
+ */
+void getTelemetrySample(TelemetrySample *sample)
+{
+	sample->distance = getDistance();
+	sample->speed = getAvgSpeed();
+	sample->sonar = dis;
+	sample->command = command;
+	sample->state = state;
+	// all pixels of one frame
+	ThermalFrame frame;
+	getThermalFrame(&frame);
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		sample->thermal[i] = frame.values[i];
+	}
+}
+
+
+/*! \brief Serve telemetry
+ *
+ * \details Web route /telemetry, responds with a binary telemetry frame; with the on-module web server
+ * the frame is sent as hexadecimal text, since only text crosses to the module.
+ *
+ * @param socket Socket of the request
+ * @param query Not used
+ *
+ */
+void serveTelemetry(TCP_SOCKET socket, char *query)
+{
+	TelemetrySample sample;
+	uint8_t frame[TELEMETRY_FRAME_SIZE];
+	int frameSize;
+
+	getTelemetrySample(&sample);
+	frameSize = encodeTelemetryFrame(frame, &sample);
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		char hexFrame[2 * TELEMETRY_FRAME_SIZE + 1];
+		for (int i = 0; i < frameSize; i++) {
+			sprintf(&hexFrame[2 * i], "%02x", frame[i]);
 		}
-		else if (client_request == 'R'){
-			command = 5;
+		send_http_response_data(socket, hexFrame);
+	#else
+		send_http_response_header(socket, "200 OK", "application/octet-stream");
+		gs_write_binary_data_to_socket(socket, frame, frameSize);
+		// let the module send the data before the connection is closed
+		vTaskDelay(150 / portTICK_PERIOD_MS);
+	#endif
+}
+
+
+/*! \brief Serve motion script
+ *
+ * \details Web route /script?s=F50,L90,S starts a motion script and responds with its id and steps,
+ * example {"id":3,"steps":3}, 400 if the script is not accepted, or 503 if the command queue is full.
+ * /script without query responds with the status of the last script, example {"id":3,"step":1,"steps":3}.
+ *
+ * @param socket Socket of the request
+ * @param query s= followed by the script
+ *
+ */
+void serveScript(TCP_SOCKET socket, char *query)
+{
+	char buffer[40];
+	uint16_t id;
+	int step;
+	int steps;
+
+	if (query[0] == 's' && query[1] == '=') {
+		int scriptId = startScript(&query[2], &steps);
+		if (scriptId < 0) {
+			send_http_response(socket, (steps < 0) ? "400 Bad Request" : "503 Service Unavailable", NULL, "");
+			return;
 		}
+		sprintf(buffer, "{\"id\":%d,\"steps\":%d}", scriptId, steps);
+	}
+	else {
+		getMotionScriptStatus(&id, &step, &steps);
+		sprintf(buffer, "{\"id\":%u,\"step\":%d,\"steps\":%d}", id, step, steps);
+	}
+	send_http_response(socket, "200 OK", "application/json", buffer);
+}
+
+
+/*! \brief Serve CPU statistics
+ *
+ * \details Web route /cpu, responds with the CPU time of the last window in permille: tasks, idle,
+ * interrupts of TIMER0, TIMER4 and TIMER5, and busy-waits, example
+ * {"ms":10000,"idle":612,"busy":45,"isr":[21,3,3],"total":7,"tasks":{"Behavior":[96,74],"IDLE":[612,40]}}
+ * each task is its permille and the stack bytes it has left at the high water mark.
+ *
+ * @param socket Socket of the request
+ * @param query Not used
+ *
+ */
+void serveCpuStats(TCP_SOCKET socket, char *query)
+{
+	// only the HTTP task serves it, kept off its stack
+	static char buffer[96 + CPU_STATS_TASKS * (CPU_STATS_NAME_SIZE + 14)];
+	char name[CPU_STATS_NAME_SIZE];
+	int length;
+	int total;
+	int tasks = getCpuStatsTasks(&total);
+
+	// total is the number of tasks, more than the tasks listed if they do not fit CPU_STATS_TASKS
+	length = sprintf(buffer, "{\"ms\":%lu,\"idle\":%u,\"busy\":%u,\"isr\":[%u,%u,%u],\"total\":%d,\"tasks\":{",
+		(unsigned long) (getCpuStatsWindow() / 1000),
+		getCpuStatsIdle(),
+		getCpuStatsBusyWait(),
+		getCpuStatsIsr(CPU_STATS_ISR_TIMER0),
+		getCpuStatsIsr(CPU_STATS_ISR_TIMER4),
+		getCpuStatsIsr(CPU_STATS_ISR_TIMER5),
+		total);
+	// each task is [permille, stack bytes left at the high water mark]
+	for (int i = 0; i < tasks; i++) {
+		uint16_t stackFree;
+		uint16_t permille = getCpuStatsTask(i, name, &stackFree);
+		length += sprintf(&buffer[length], "%s\"%s\":[%u,%u]", (i > 0) ? "," : "", name, permille, stackFree);
 	}
+	strcpy(&buffer[length], "}}");
+	send_http_response(socket, "200 OK", "application/json", buffer);
+}
+
+
+/*! \brief Start WiFi.
+ *
+ * \details Initialize the Gainspan module, activate the wireless connection, configure the web-page
+ * and start the web server. Called by the HTTP task before its first request, it takes several seconds;
+ * the Gainspan driver busy-waits for the module, which only delays tasks below the HTTP task.
+ *
+ *
+ * @return void
+ *
+ *
+ */
+void startWiFi(void) {
+	gs_initialize_module(usart_two, BAUD_RATE_9600, usart_zero, BAUD_RATE_115200);
+	gs_set_wireless_ssid("HP-Print-900-LaserCat");
+	gs_activate_wireless_connection();
+
+	configure_web_page("Chico", "Chico Control", HTML_DROPDOWN_LIST);
+
+	add_element_choice('A', "Attach"); // Attach
+	add_element_choice('S', "Stop"); // Stop
+	add_element_choice('F', "Forward"); // Up arrow, forward
+	add_element_choice('B', "Backward"); // Down, backward
+	add_element_choice('L', "Left"); // Counter clockwise, spin left
+	add_element_choice('R', "Right"); // Clockwise, spin right
+	add_web_route("/telemetry", serveTelemetry); // binary telemetry frame
+	add_web_route(HEAT_MAP_PAGE_ROUTE, serveHeatMapPage); // live thermal heat map
+	add_web_route(HEAT_MAP_UPDATE_ROUTE, serveHeatMapUpdate); // heat map updates, polled by the page
+	add_web_route("/script", serveScript); // motion script
+	add_web_route("/cpu", serveCpuStats); // CPU time of tasks
+
+	start_web_server();
+	vTaskDelay(3000 / portTICK_PERIOD_MS);
 }
 
 
@@ -191,6 +470,11 @@ void serve_client_request(void)
  *
  * \details Task - Accept, process HTTP requests
  * request and process client response to the web-page via submission i.e. user selection.
+ * Starts WiFi before the first request, refer startWiFi().
+ * Runs every 250ms; a heat map poll takes around half a second to arrive at 9600 baud, so the page polls once a
+ * second, and the admission control of the web server keeps requests within budget.
+ * Pushes a telemetry record to the collector every 4 cycles.
+ * Reports WiFi driver statistics to serial terminal every 240 cycles, when Gainspan terminal output is on.
  *
  *
  * @return void
@@ -199,16 +483,41 @@ void serve_client_request(void)
  */
 void taskHandleHttp(void *pvParameters) {
 	TickType_t xLastWakeTime;
+	int cycleCount = 0;
+	TelemetrySample sample;
+
+	startWiFi();
 	xLastWakeTime = xTaskGetTickCount();
 
+	/*Only this task uses WiFi, so the telemetry connection is opened here*/
+	initTelemetry(ROBOT_ID, TELEMETRY_COLLECTOR_ADDRESS, TELEMETRY_COLLECTOR_PORT);
+
 	while(1) {
 		/*Accept and serve the HTTP request by sending web page*/
 		process_client_request();
 		/*Serve client response/request:submission of user selection from web-page */
 		serve_client_request();
+
+		cycleCount++;
+
+		/*Push telemetry to collector about every second*/
+		if (cycleCount % 4 == 0) {
+			getTelemetrySample(&sample);
+			sendTelemetry(&sample);
+		}
+
+		#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+			/*Report WiFi driver statistics about every minute*/
+			if (cycleCount >= 240) {
+				gs_send_statistics_to_serial_terminal();
+			}
+		#endif
+		if (cycleCount >= 240) {
+			cycleCount = 0;
+		}
 		/*Relinquish the processor*/
 
-		vTaskDelayUntil(&xLastWakeTime, (5500 / portTICK_PERIOD_MS)); //Cycle 5500ms
+		vTaskDelayUntil(&xLastWakeTime, (250 / portTICK_PERIOD_MS)); //Cycle 250ms
 	}
 }
 
@@ -236,7 +545,7 @@ void taskSpeedMonitor(void *pvParameters) {
 /* ---------------------------------------------------------------------------*/
 /*!\brief taskBehavior
  *
- * \details initializes thermal sensor scanning
+ * \details spins the thermal sensor, read by the thermal task
  * control the behavior of chico
  *
  *   @param *pvParameters
@@ -245,13 +554,18 @@ void taskSpeedMonitor(void *pvParameters) {
 void taskBehavior(void *pvParameters) {
 	TickType_t xLastWakeTime;
 	xLastWakeTime = xTaskGetTickCount();
-	initThermal();
+	BehaviorCommand next;
 
 	while(1) {
+		// take the commands sent since the last cycle, the latest wins
+		while (xQueueReceive(commandQueue, &next, 0) == pdTRUE) {
+			command = next.command;
+			moveCycles = next.cycles;
+			moveCount = 0;
+		}
+
 		// start thermal sensor scanning
 		spinSensor();
-		readTemperatures();
-		updateTimeDistance();
 		dis = getSonarDistance();
 		closeHeat = closeToHeat();
 
@@ -298,9 +612,14 @@ void taskBehavior(void *pvParameters) {
 					moveCount = 0;
 					stopMotion();
 				}
-				// turn direction if
+				// heat lost while close: spin toward the heat bearing when known, left otherwise
 				else if (dis < 40) {
-					spinLeft();
+					if (getHeatBearing(&heatBearing) > 0 && heatBearing < 0) {
+						spinRight();
+					}
+					else {
+						spinLeft();
+					}
 				}
 				else {
 					moveCount++;
@@ -330,7 +649,7 @@ void taskBehavior(void *pvParameters) {
 			moveForward();
 			openGreenLED();
 			moveCount++;
-			if (moveCount > 5) {
+			if (moveCount >= moveCycles) {
 				moveCount = 0;
 				command = 0;
 			}
@@ -339,7 +658,7 @@ void taskBehavior(void *pvParameters) {
 			moveBackward();
 			openRedLED();
 			moveCount++;
-			if (moveCount > 5) {
+			if (moveCount >= moveCycles) {
 				moveCount = 0;
 				command = 0;
 			}
@@ -348,7 +667,7 @@ void taskBehavior(void *pvParameters) {
 			spinLeft();
 			openBlueLED();
 			moveCount++;
-			if (moveCount >= 1) {
+			if (moveCount >= moveCycles) {
 				moveCount = 0;
 				command = 0;
 			}
@@ -357,20 +676,65 @@ void taskBehavior(void *pvParameters) {
 			spinRight();
 			openBlueLED();
 			moveCount++;
-			if (moveCount >= 1) {
+			if (moveCount >= moveCycles) {
 				moveCount = 0;
 				command = 0;
 			}
 		}
+		else if (command == 6) { // Motion script
+			openGreenLED();
+			if (runMotionScript() == 0) {
+				command = 0;
+			}
+		}
 
 		vTaskDelayUntil(&xLastWakeTime, (250 / portTICK_PERIOD_MS));  //Cycle 250ms
 	}
 
 }
 
+/* ---------------------------------------------------------------------------*/
+/*!\brief taskSonar
+ *
+ * \details filters each sonar measurement timed by the interrupts, checks it for collision and adds it to the range map;
+ * sleeps until the next measurement
+ *
+ *   @param *pvParameters
+ *
+ *----------------------------------------------------------------------------*/
+void taskSonar(void *pvParameters) {
+	while(1) {
+		processSonarMeasurement();
+	}
+}
+
+/* ---------------------------------------------------------------------------*/
+/*!\brief taskThermal
+ *
+ * \details initializes the thermal sensor and acquires a frame every THERMAL_FRAME_PERIOD,
+ * sleeps while the I2C transfer is driven by the TWI interrupt; then steps the sensor sweep when a step is due,
+ * so the sweep sees the latest frame
+ *
+ *   @param *pvParameters
+ *
+ *----------------------------------------------------------------------------*/
+void taskThermal(void *pvParameters) {
+	TickType_t xLastWakeTime;
+	xLastWakeTime = xTaskGetTickCount();
+	initThermal();
+
+	while(1) {
+		acquireThermalFrame();
+		updateSensorSweep();
+
+		vTaskDelayUntil(&xLastWakeTime, (THERMAL_FRAME_PERIOD / portTICK_PERIOD_MS));
+	}
+}
+
 /*\brief LCD task.
  *
  *\details Update LCD according to the current temperatures recorded using two buffers.
+ * Updates CPU statistics every 20 cycles.
  *
  * @param *pvParameters A value that will passed into the created task as the task's parameter.
  */
@@ -381,6 +745,7 @@ void taskLCD(void *pvParameters) {
 	// LCD message buffers
 	char line1Buffer[16];
 	char line2Buffer[16];
+	int cycleCount = 0;
 
 	while (1) {
 		// write messages to buffers
@@ -397,11 +762,220 @@ void taskLCD(void *pvParameters) {
 		// update LCD display
 		printLCD(line1Buffer, line2Buffer);
 
+		// CPU statistics window of about 10 seconds
+		cycleCount++;
+		if (cycleCount >= 20) {
+			cycleCount = 0;
+			updateCpuStats();
+		}
+
 		// task interval
 		vTaskDelayUntil(&xLastWakeTime, (500 / portTICK_PERIOD_MS));  //Cycle 500ms
 	}
 }
 
+/* ---------------------------------------------------------------------------*/
+/*!\brief taskConsole
+ *
+ *\details serial console on USART0, reads received characters into a line
+ * and executes each complete line, refer consoleParseLine for the commands
+ * reports motion script steps as they are completed
+ *
+ *   @param *pvParameters
+ *
+ *----------------------------------------------------------------------------*/
+void taskConsole(void *pvParameters) {
+	ConsoleLine line;
+	ConsoleCommand consoleCommand;
+	MotionScriptEvent event;
+	char buffer[48];
+	uint8_t c;
+
+	consoleClearLine(&line);
+
+	while(1) {
+		// USART0 receive is interrupt driven and buffered, empty the buffer
+		while (usart_AvailableCharRx(usart_zero)) {
+			usart_xgetChar(usart_zero, &c);
+			if (consoleAddChar(&line, (char) c)) {
+				consoleParseLine(line.buffer, &consoleCommand);
+				executeConsoleCommand(&consoleCommand);
+				consoleClearLine(&line);
+			}
+		}
+		while (getMotionScriptEvent(&event)) {
+			sprintf(buffer, "\r\nscript %u step %u %c done%s\r\n",
+				event.id,
+				event.step + 1,
+				event.move,
+				event.last ? ", end" : "");
+			usart_xfprint(usart_zero, (uint8_t *) buffer);
+		}
+		vTaskDelay(10 / portTICK_PERIOD_MS); //Poll 10ms
+	}
+}
+
+/*!\brief Execute a console command
+ *
+ *\details moves set the command of behavior task, queries reply with the latest values
+ * read by behavior task, so the console does not access the sensors itself
+ *
+ * @param *consoleCommand Parsed console command
+ */
+void executeConsoleCommand(ConsoleCommand *consoleCommand) {
+	char buffer[64];
+
+	switch (consoleCommand->type) {
+	case CONSOLE_MOVE: {
+		int cycles = setCommand(consoleCommand->move, consoleCommand->cycles);
+		if (cycles < 0) {
+			strcpy(buffer, "\r\nbusy\r\n");
+		}
+		else {
+			sprintf(buffer, "\r\nok %c %d\r\n", consoleCommand->move, cycles);
+		}
+		break;
+	}
+	case CONSOLE_QUERY_TEMPERATURE: {
+		uint16_t motion;
+		uint8_t foreground = getThermalForeground(&motion);
+		double bearing;
+		int confidence = getHeatBearing(&bearing);
+		sprintf(buffer, "\r\nA:%d L:%d C:%d R:%d F:%02X M:%u B:%+.1f/%d\r\n",
+			getSensorValue(0),
+			getLeftAvg(),
+			getCenterAvg(),
+			getRightAvg(),
+			foreground,
+			motion,
+			bearing,
+			confidence);
+		break;
+	}
+	case CONSOLE_QUERY_SONAR: {
+		SonarRange range;
+		uint16_t brakes;
+		int brake = getCollisionBrake(&brakes);
+		if (getSonarRange(&range)) {
+			sprintf(buffer, "\r\nD:%.1f %+.1fcm/s brake:%d/%u\r\n", range.distance, range.rate, brake, brakes);
+		}
+		else {
+			strcpy(buffer, "\r\nD:no echo\r\n");
+		}
+		break;
+	}
+	case CONSOLE_QUERY_SPEED:
+		sprintf(buffer, "\r\nS:%.2f D:%.2f\r\n",
+			getAvgSpeed(),
+			getDistance());
+		break;
+	case CONSOLE_SCRIPT: {
+		int steps;
+		int id = startScript(consoleCommand->script, &steps);
+		if (id < 0) {
+			strcpy(buffer, (steps < 0) ? "\r\nerror\r\n" : "\r\nbusy\r\n");
+		}
+		else {
+			sprintf(buffer, "\r\nok script %d, %d steps\r\n", id, steps);
+		}
+		break;
+	}
+	case CONSOLE_QUERY_STATISTICS:
+		gs_send_statistics_to_serial_terminal();
+		return;
+	case CONSOLE_QUERY_CPU:
+		printCpuStats();
+		return;
+	case CONSOLE_QUERY_OBSTACLE: {
+		double distance;
+		double obstacleBearing;
+		double freeBearing;
+		int length = 0;
+		if (getNearestObstacle(&distance, &obstacleBearing)) {
+			length = sprintf(buffer, "\r\nO:%.0fcm %+.0fdeg", distance, obstacleBearing);
+		}
+		else {
+			length = sprintf(buffer, "\r\nO:none");
+		}
+		if (getFreeDirection(FREE_DIRECTION_DISTANCE, &freeBearing)) {
+			sprintf(&buffer[length], " free:%+.0fdeg\r\n", freeBearing);
+		}
+		else {
+			strcpy(&buffer[length], " free:none\r\n");
+		}
+		break;
+	}
+	case CONSOLE_QUERY_PANORAMA: {
+		double hottestBearing;
+		uint8_t temperature;
+		if (getHottestDirection(&hottestBearing, &temperature)) {
+			sprintf(buffer, "\r\nP:%+.0fdeg %dC\r\n", hottestBearing, temperature);
+		}
+		else {
+			strcpy(buffer, "\r\nP:none\r\n");
+		}
+		break;
+	}
+	case CONSOLE_QUERY_TELEMETRY: {
+		// binary frame only, no text around it
+		TelemetrySample sample;
+		uint8_t frame[TELEMETRY_FRAME_SIZE];
+		getTelemetrySample(&sample);
+		int frameSize = encodeTelemetryFrame(frame, &sample);
+		for (int i = 0; i < frameSize; i++) {
+			usartWrite(usart_zero, frame[i]);
+		}
+		return;
+	}
+	case CONSOLE_HELP:
+		usart_xfprint(usart_zero, (uint8_t *) "\r\nS A F[cm] B[cm] L[deg] R[deg]");
+		usart_xfprint(usart_zero, (uint8_t *) "\r\nM F50,L90,S: script");
+		usart_xfprint(usart_zero, (uint8_t *) "\r\nT:temp D:sonar O:obstacle P:panorama");
+		strcpy(buffer, "\r\nV:speed W:wifi C:cpu Z:binary\r\n");
+		break;
+	default:
+		strcpy(buffer, "\r\nerror\r\n");
+		break;
+	}
+	usart_xfprint(usart_zero, (uint8_t *) buffer);
+}
+
+/*!\brief Print CPU statistics
+ *
+ *\details CPU time of the last window in percent, one line for interrupts and busy-waits,
+ * then a line per task
+ */
+void printCpuStats(void) {
+	char buffer[64];
+	char name[CPU_STATS_NAME_SIZE];
+	uint16_t busy = getCpuStatsBusyWait();
+	uint16_t isr[CPU_STATS_ISR_SOURCES];
+	int total;
+	int tasks = getCpuStatsTasks(&total);
+
+	for (int i = 0; i < CPU_STATS_ISR_SOURCES; i++) {
+		isr[i] = getCpuStatsIsr(i);
+	}
+	sprintf(buffer, "\r\n%lums busy:%u.%u%% T0:%u.%u%% T4:%u.%u%% T5:%u.%u%%",
+		(unsigned long) (getCpuStatsWindow() / 1000),
+		busy / 10, busy % 10,
+		isr[0] / 10, isr[0] % 10,
+		isr[1] / 10, isr[1] % 10,
+		isr[2] / 10, isr[2] % 10);
+	usart_xfprint(usart_zero, (uint8_t *) buffer);
+	for (int i = 0; i < tasks; i++) {
+		uint16_t stackFree;
+		uint16_t permille = getCpuStatsTask(i, name, &stackFree);
+		sprintf(buffer, "\r\n%s:%u.%u%% stack free:%u", name, permille / 10, permille % 10, stackFree);
+		usart_xfprint(usart_zero, (uint8_t *) buffer);
+	}
+	if (tasks < total) {
+		sprintf(buffer, "\r\n%d tasks, more than %d", total, CPU_STATS_TASKS);
+		usart_xfprint(usart_zero, (uint8_t *) buffer);
+	}
+	usart_xfprint(usart_zero, (uint8_t *) "\r\n");
+}
+
 /*\brief Application Stack Overflow
  *
  *\details
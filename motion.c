@@ -8,6 +8,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "include/motion.h"
+#include "include/cpuStats.h"
 
 /******************************************************************************
  *    DEFINES
@@ -87,6 +88,9 @@ static volatile uint16_t last_icr[ENC_NUMBER_OF_ENCODERS];
 static volatile uint32_t new_data[ENC_NUMBER_OF_ENCODERS];
 static volatile int      new_data_available[ENC_NUMBER_OF_ENCODERS];
 
+/* Input capture events since the last motion_enc_count() */
+static volatile uint16_t edge_count[ENC_NUMBER_OF_ENCODERS];
+
 static const struct tc_module_registers tc_module_s[] =
 {
 	/* Using the Waveform Generation Mode 15 (OCRA holds the TOP value). */
@@ -243,7 +247,7 @@ void motion_init(void)
 
 void motion_servo_start(int deviceId)
 {
-	uint16_t pulse_width_cycles = *(motors[deviceId].OCR_ptr);
+	uint16_t pulse_width_cycles = motion_servo_get_pulse_width(deviceId);
 
 
 	/* This will ensure that the pulse width is within an acceptable range. */
@@ -251,7 +255,7 @@ void motion_servo_start(int deviceId)
 	if (!(pulse_width_cycles <= MAX_PULSE_WIDTH_TICKS &&
 		  pulse_width_cycles >= MIN_PULSE_WIDTH_TICKS))
 	{
-		*(motors[deviceId].OCR_ptr) = INITIAL_PULSE_WIDTH_TICKS;
+		motion_servo_set_pulse_width(deviceId, INITIAL_PULSE_WIDTH_TICKS);
 	}
 
 
@@ -323,14 +327,22 @@ void motion_servo_stop(int deviceId)
  *     The pulse width length in ticks.
  *
  * Sets the pulse width by changing the value of the Output Compare Register.
+ * Interrupts are masked during the write: the 16-bit register is written
+ * through the TEMP register of the Timer/Counter, which the encoder ISR
+ * also uses when it reads ICRn.
  *----------------------------------------------------------------------------*/
 
 void motion_servo_set_pulse_width(int deviceId, uint16_t pulse_width_cycles)
 {
+	uint8_t sreg;
+
 	if (pulse_width_cycles <= MAX_PULSE_WIDTH_TICKS &&
 		pulse_width_cycles >= MIN_PULSE_WIDTH_TICKS)
 	{
+		sreg = SREG;
+		cli(); /* mask interrupts, restored as they were */
 		*(motors[deviceId].OCR_ptr) = pulse_width_cycles;
+		SREG = sreg;
 	}
 }
 
@@ -348,12 +360,20 @@ void motion_servo_set_pulse_width(int deviceId, uint16_t pulse_width_cycles)
  * Return value:
  *   The current pulse width length (in ticks).
  *
- * Returns the pulse width by reading the value of the Output Compare Register.
+ * Returns the pulse width by reading the value of the Output Compare Register,
+ * with interrupts masked, refer motion_servo_set_pulse_width().
  *----------------------------------------------------------------------------*/
 
 uint16_t motion_servo_get_pulse_width(int deviceId)
 {
-    return *(motors[deviceId].OCR_ptr);
+	uint8_t  sreg = SREG;
+	uint16_t pulse_width_cycles;
+
+	cli(); /* mask interrupts, restored as they were */
+	pulse_width_cycles = *(motors[deviceId].OCR_ptr);
+	SREG = sreg;
+
+	return pulse_width_cycles;
 }
 
 
@@ -398,6 +418,38 @@ int motion_enc_read(int deviceId, uint32_t *val)
 }
 
 
+/*----------------------------------------------------------------------------
+ * motion_enc_count -- count the transitions of an optical encoder
+ *
+ * Parameter:
+ *   - int deviceId
+ *     The valid options are:
+ *         MOTION_WHEEL_LEFT
+ *         MOTION_WHEEL_RIGHT
+ *
+ * Return value:
+ *   The number of input capture events since the previous call, and
+ *   resets it. Unlike motion_enc_read(), which only keeps the latest
+ *   period, no event is lost between two polls.
+ *
+ *----------------------------------------------------------------------------*/
+
+uint16_t motion_enc_count(int deviceId)
+{
+	uint8_t  sreg = SREG;
+	uint16_t count;
+
+	cli(); /* mask interrupts, restored as they were */
+
+	count = edge_count[deviceId];
+	edge_count[deviceId] = 0;
+
+	SREG = sreg;
+
+	return count;
+}
+
+
 /******************************************************************************
  *    Motion Module Local Functions
  ******************************************************************************/
@@ -705,22 +757,30 @@ static inline void enc_init(int enc_id)
 
 ISR(TIMER4_OVF_vect)
 {
+    CPU_STATS_ISR_ENTER();
     increment_tov_cntr(MOTION_WHEEL_LEFT);
+    CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER4);
 }
 
 ISR(TIMER5_OVF_vect)
 {
+    CPU_STATS_ISR_ENTER();
     increment_tov_cntr(MOTION_WHEEL_RIGHT);
+    CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER5);
 }
 
 ISR(TIMER4_CAPT_vect)
 {
+    CPU_STATS_ISR_ENTER();
     handle_transition(MOTION_WHEEL_LEFT);
+    CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER4);
 }
 
 ISR(TIMER5_CAPT_vect)
 {
+    CPU_STATS_ISR_ENTER();
     handle_transition(MOTION_WHEEL_RIGHT);
+    CPU_STATS_ISR_EXIT(CPU_STATS_ISR_TIMER5);
 }
 
 static inline void increment_tov_cntr(int enc_id)
@@ -756,5 +816,7 @@ static inline void handle_transition(int enc_id)
 
 	new_data_available[enc_id] = 1;
 
+	edge_count[enc_id]++;
+
 	last_icr[enc_id] = icr;
 }
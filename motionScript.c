@@ -0,0 +1,181 @@
+/*
+ * motionScript.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file motionScript.c
+ *
+ * Module for motion scripts, called by main Chico module
+ * A script is compiled to a compact bytecode, then executed step by step by behavior task,
+ * one behavior cycle at a time, so steps run back to back
+ ------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "include/motionScript.h"
+#include "include/console.h"
+#include "include/wheelControl.h"
+
+// script being executed
+MotionScript runningScript;
+uint16_t runningScriptId = 0;
+int runningStep = 0;
+int runningStepCycles = 0;
+
+// step completion events, read by console task
+QueueHandle_t motionScriptEvents;
+
+/*!\brief Compile a motion script.
+ *
+ *\details Each step is parsed as a console line, so steps take the same moves and arguments as the console;
+ * spaces around steps are allowed. Distances and angles are converted to behavior cycles.
+ * Returns the number of steps, -1 if the script is empty, too long or a step is not accepted.
+ */
+int compileMotionScript(const char *text, MotionScript *script) {
+	char step[CONSOLE_LINE_SIZE];
+	ConsoleCommand command;
+	const char *end;
+	size_t length;
+	int cycles;
+
+	script->steps = 0;
+	while (1) {
+		end = strchr(text, ',');
+		length = (end != NULL) ? (size_t) (end - text) : strlen(text);
+		if (length >= CONSOLE_LINE_SIZE || script->steps >= MOTION_SCRIPT_STEPS) {
+			return -1;
+		}
+		memcpy(step, text, length);
+		step[length] = '\0';
+
+		if (consoleParseLine(step, &command) != CONSOLE_MOVE || command.move == 'A') {
+			return -1;
+		}
+		cycles = command.cycles;
+		if (cycles == 0) {
+			if (command.move == 'F' || command.move == 'B') {
+				cycles = MOTION_SCRIPT_MOVE_CYCLES;
+			}
+			else if (command.move == 'L' || command.move == 'R') {
+				cycles = MOTION_SCRIPT_SPIN_CYCLES;
+			}
+			else {
+				cycles = MOTION_SCRIPT_STOP_CYCLES;
+			}
+		}
+		script->code[script->steps * MOTION_SCRIPT_STEP_SIZE] = command.move;
+		script->code[script->steps * MOTION_SCRIPT_STEP_SIZE + 1] = cycles;
+		script->steps++;
+
+		if (end == NULL) {
+			return script->steps;
+		}
+		text = end + 1;
+	}
+}
+
+/*!\brief Initialize motion script executor.
+ *
+ *\details Create the step completion event queue, call before the scheduler starts.
+ */
+void initMotionScript(void) {
+	motionScriptEvents = xQueueCreate(MOTION_SCRIPT_STEPS, sizeof(MotionScriptEvent));
+	runningScript.steps = 0;
+}
+
+/*!\brief Load a motion script for execution.
+ *
+ *\details Replaces the script being executed, execution starts on the next runMotionScript().
+ * Returns the id of the script.
+ */
+uint16_t loadMotionScript(const MotionScript *script) {
+	taskENTER_CRITICAL();
+	runningScript = *script;
+	runningScriptId++;
+	runningStep = 0;
+	runningStepCycles = 0;
+	taskEXIT_CRITICAL();
+	return runningScriptId;
+}
+
+/*!\brief Run a behavior cycle of the motion script.
+ *
+ *\details Called by behavior task every cycle while the script command is set, drives the wheels
+ * for the current step. Sends a completion event when a step has run its cycles, and the next step
+ * starts on the next cycle.
+ * Returns 1 while the script has steps left, 0 when it is done.
+ */
+int runMotionScript(void) {
+	MotionScriptEvent event;
+	char move;
+	int stepDone = 0;
+
+	taskENTER_CRITICAL();
+	if (runningStep >= runningScript.steps) {
+		taskEXIT_CRITICAL();
+		return 0;
+	}
+	move = runningScript.code[runningStep * MOTION_SCRIPT_STEP_SIZE];
+	runningStepCycles++;
+	event.id = runningScriptId;
+	event.step = runningStep;
+	event.move = move;
+	event.last = 0;
+	if (runningStepCycles >= runningScript.code[runningStep * MOTION_SCRIPT_STEP_SIZE + 1]) {
+		runningStep++;
+		runningStepCycles = 0;
+		event.last = (runningStep >= runningScript.steps) ? 1 : 0;
+		stepDone = 1;
+	}
+	taskEXIT_CRITICAL();
+
+	// wheel primitives wait for the cycle, not in the critical section
+	switch (move) {
+	case 'F':
+		moveForward();
+		break;
+	case 'B':
+		moveBackward();
+		break;
+	case 'L':
+		spinLeft();
+		break;
+	case 'R':
+		spinRight();
+		break;
+	default:
+		stopMotion();
+		break;
+	}
+
+	// an event is dropped if the console has not read the previous ones
+	if (stepDone) {
+		xQueueSend(motionScriptEvents, &event, 0);
+	}
+	return !event.last;
+}
+
+/*!\brief Get the next step completion event.
+ *
+ *\details Does not wait. Returns 1 if an event was read, 0 if there is none.
+ */
+int getMotionScriptEvent(MotionScriptEvent *event) {
+	return xQueueReceive(motionScriptEvents, event, 0) == pdTRUE;
+}
+
+/*!\brief Get the motion script status.
+ *
+ *\details Id of the last loaded script, steps completed and steps of the script.
+ */
+void getMotionScriptStatus(uint16_t *id, int *step, int *steps) {
+	taskENTER_CRITICAL();
+	*id = runningScriptId;
+	*step = runningStep;
+	*steps = runningScript.steps;
+	taskEXIT_CRITICAL();
+}
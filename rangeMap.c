@@ -0,0 +1,131 @@
+/*
+ * rangeMap.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file rangeMap.c
+ *
+ * Module for the polar range map, called by sonar and main Chico modules
+ * Each sonar reading is kept in the bin of the heading it was measured at, so the surroundings are known
+ * from the sweeps and spins already made, without stopping to rescan
+ ------------------------------------------------------------------*/
+
+#include <math.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "include/rangeMap.h"
+#include "include/custom_timer.h"
+#include "include/wheelControl.h"
+
+#define RANGE_MAP_BIN_DEGREES (360.0 / RANGE_MAP_BINS)
+
+// distance in cm and time in milliseconds of the last reading of each bin, written by the sonar task
+uint16_t rangeMapDistances[RANGE_MAP_BINS];
+unsigned long rangeMapTimes[RANGE_MAP_BINS];
+uint8_t rangeMapKnown[RANGE_MAP_BINS];
+
+/*!\brief Bearing of a bin.
+ *
+ *\details Angle from a heading to the center of a bin, -180 to 180 degrees, positive counter-clockwise.
+ */
+double bearingOfBin(int bin, double heading) {
+	double bearing = (bin + 0.5) * RANGE_MAP_BIN_DEGREES - heading;
+
+	if (bearing > 180) {
+		bearing -= 360;
+	}
+	else if (bearing <= -180) {
+		bearing += 360;
+	}
+	return bearing;
+}
+
+/*!\brief Update the range map.
+ *
+ *\details Called by the sonar task with each filtered range; the sonar looks ahead, so the reading goes
+ * to the bin of the heading. A range that is not valid is taken as free, nothing within range.
+ */
+void updateRangeMap(double heading, int valid, double distance) {
+	int bin = (int) (heading / RANGE_MAP_BIN_DEGREES) % RANGE_MAP_BINS;
+
+	if (!valid || distance > RANGE_MAP_FREE_DISTANCE) {
+		distance = RANGE_MAP_FREE_DISTANCE;
+	}
+	taskENTER_CRITICAL();
+	rangeMapDistances[bin] = (uint16_t) distance;
+	rangeMapTimes[bin] = time_in_milliseconds();
+	rangeMapKnown[bin] = 1;
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief Get a bin of the range map.
+ *
+ *\details Distance in cm and age in milliseconds of the last reading of a bin.
+ * Returns 1 if the bin is known and not older than RANGE_MAP_MAX_AGE, 0 otherwise.
+ */
+int getRangeMapBin(int bin, uint16_t *distance, uint32_t *age) {
+	int known;
+
+	taskENTER_CRITICAL();
+	known = rangeMapKnown[bin];
+	*distance = rangeMapDistances[bin];
+	*age = time_in_milliseconds() - rangeMapTimes[bin];
+	taskEXIT_CRITICAL();
+	return known && *age <= RANGE_MAP_MAX_AGE;
+}
+
+/*!\brief Get the nearest obstacle.
+ *
+ *\details Nearest distance in cm among the bins that are known, and its bearing from the current heading in
+ * degrees, positive to the left. The map has a fixed number of bins, so the time does not depend on the readings.
+ * Returns 1 if an obstacle is known, 0 otherwise.
+ */
+int getNearestObstacle(double *distance, double *bearing) {
+	double heading = getHeading();
+	uint16_t binDistance;
+	uint32_t age;
+	int nearest = -1;
+
+	*distance = RANGE_MAP_FREE_DISTANCE;
+	for (int bin = 0; bin < RANGE_MAP_BINS; bin++) {
+		if (getRangeMapBin(bin, &binDistance, &age) && binDistance < *distance) {
+			*distance = binDistance;
+			nearest = bin;
+		}
+	}
+	if (nearest < 0) {
+		*bearing = 0;
+		return 0;
+	}
+	*bearing = bearingOfBin(nearest, heading);
+	return 1;
+}
+
+/*!\brief Get a free direction.
+ *
+ *\details Bearing from the current heading in degrees, positive to the left, of the known bin closest to the
+ * heading with nothing nearer than a distance in cm.
+ * Returns 1 if a free direction is known, 0 otherwise.
+ */
+int getFreeDirection(double minDistance, double *bearing) {
+	double heading = getHeading();
+	double binBearing;
+	uint16_t binDistance;
+	uint32_t age;
+	int found = 0;
+
+	*bearing = 0;
+	for (int bin = 0; bin < RANGE_MAP_BINS; bin++) {
+		if (getRangeMapBin(bin, &binDistance, &age) && binDistance >= minDistance) {
+			binBearing = bearingOfBin(bin, heading);
+			if (!found || fabs(binBearing) < fabs(*bearing)) {
+				*bearing = binBearing;
+				found = 1;
+			}
+		}
+	}
+	return found;
+}
@@ -0,0 +1,97 @@
+/*
+ * sensorSweep.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file sensorSweep.c
+ *
+ * Module for the sweep of the thermal sensor, called by wheel control module
+ * A coarse sweep looks for heat, then the sensor jumps to the heat bearing and holds it, sweeping finer and wider
+ * around it while it is not seen; the policy does not touch any hardware, so it can be replayed from any source
+ ------------------------------------------------------------------*/
+
+#include "include/sensorSweep.h"
+#include "include/thermalSensor.h"
+#include "include/motion.h"
+
+/*!\brief Clamp a servo position to the sweep.
+ *
+ *\details Positions beyond SENSOR_SWEEP_MIN and SENSOR_SWEEP_MAX are moved to them.
+ */
+uint16_t clampSweepPosition(long position) {
+	if (position < SENSOR_SWEEP_MIN) {
+		return SENSOR_SWEEP_MIN;
+	}
+	if (position > SENSOR_SWEEP_MAX) {
+		return SENSOR_SWEEP_MAX;
+	}
+	return (uint16_t) position;
+}
+
+/*!\brief Initialize a sensor sweep.
+ *
+ *\details Coarse sweep from a servo position, toward SENSOR_SWEEP_MAX.
+ */
+void initSensorSweep(SensorSweep *sweep, uint16_t position) {
+	sweep->mode = SENSOR_SWEEP_COARSE;
+	sweep->position = clampSweepPosition(position);
+	sweep->direction = 1;
+	sweep->target = sweep->position;
+	sweep->lost = 0;
+}
+
+/*!\brief Step a sensor sweep.
+ *
+ *\details Called once per sensor step with the heat bearing of the latest frame, refer getHeatBearing;
+ * returns the next servo position.
+ * - Heat with at least SENSOR_SWEEP_ACQUIRE_CONFIDENCE is a target: the sensor jumps to look at its bearing,
+ *   or holds still when it is within SENSOR_SWEEP_DEADBAND, so the background of the pixels can be learned.
+ * - Without heat the sensor sweeps around the target, SENSOR_SWEEP_FINE_STEP to one side then the other, wider
+ *   each step; after SENSOR_SWEEP_LOST_STEPS the target is lost.
+ * - Without target the coarse sweep goes from end to end by SENSOR_SWEEP_COARSE_STEP, only if coarse is set.
+ */
+uint16_t stepSensorSweep(SensorSweep *sweep, int coarse, int confidence, double bearing) {
+	long offset;
+	long target;
+
+	if (confidence >= SENSOR_SWEEP_ACQUIRE_CONFIDENCE) {
+		// bearing is positive to the left, the servo turns right as the pulse width grows
+		target = INITIAL_PULSE_WIDTH_TICKS - (long) (bearing / THERMAL_SERVO_DEGREES_PER_TICK);
+		sweep->target = clampSweepPosition(target);
+		sweep->mode = SENSOR_SWEEP_TRACK;
+		sweep->lost = 0;
+		offset = (long) sweep->target - sweep->position;
+		if (offset > SENSOR_SWEEP_DEADBAND || offset < -SENSOR_SWEEP_DEADBAND) {
+			sweep->position = sweep->target;
+		}
+		return sweep->position;
+	}
+
+	if (sweep->mode == SENSOR_SWEEP_TRACK) {
+		sweep->lost++;
+		if (sweep->lost <= SENSOR_SWEEP_LOST_STEPS) {
+			// 1 step right, 1 step left, 2 steps right, ...
+			offset = (long) ((sweep->lost + 1) / 2) * SENSOR_SWEEP_FINE_STEP;
+			if (sweep->lost % 2 == 0) {
+				offset = -offset;
+			}
+			sweep->position = clampSweepPosition((long) sweep->target + offset);
+			return sweep->position;
+		}
+		// lost, the coarse sweep goes on from where the target was
+		sweep->mode = SENSOR_SWEEP_COARSE;
+		sweep->position = sweep->target;
+	}
+
+	if (coarse) {
+		if ((long) sweep->position + SENSOR_SWEEP_COARSE_STEP * sweep->direction > SENSOR_SWEEP_MAX) {
+			sweep->direction = -1;
+		}
+		else if ((long) sweep->position + SENSOR_SWEEP_COARSE_STEP * sweep->direction < SENSOR_SWEEP_MIN) {
+			sweep->direction = 1;
+		}
+		sweep->position = clampSweepPosition((long) sweep->position + SENSOR_SWEEP_COARSE_STEP * sweep->direction);
+	}
+	return sweep->position;
+}
@@ -12,55 +12,397 @@
  */
 
 
+#include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "include/sonar.h"
 #include "include/custom_timer.h"
+#include "include/wheelControl.h"
+#include "include/rangeMap.h"
 
+// measurement state, the echo is timed by the pin change interrupt
+#define SONAR_IDLE 0
+#define SONAR_WAIT_RISE 1
+#define SONAR_WAIT_FALL 2
 
-/*!\brief Initialize the sonar module
+// sound speed in air = 340m/s = 0.034cm/us, round-trip so divided by 2
+#define SONAR_CM_PER_MICROSECOND (0.034 / 2)
+// echo width of a measurement without echo, in the history
+#define SONAR_NO_ECHO_WIDTH ((uint32_t) (SONAR_NO_ECHO_DISTANCE / SONAR_CM_PER_MICROSECOND))
+
+// Hampel filter: a sample further than 3 scaled median absolute deviations (1.4826 * 3, about 89 / 20) from the
+// median of the history is replaced by the median; never closer than about 1 cm, so a still target is not rejected
+#define SONAR_HAMPEL_SCALE_NUMERATOR 89
+#define SONAR_HAMPEL_SCALE_DENOMINATOR 20
+#define SONAR_HAMPEL_MIN_THRESHOLD 60
+// echoes in the history for a valid range, and periods without measurement before it is stale
+#define SONAR_VALID_ECHOES 3
+#define SONAR_STALE_PERIODS 3
+// measurements waiting for the sonar task, refer processSonarMeasurement()
+#define SONAR_QUEUE_LENGTH 2
+
+// measurement sent by the interrupts to the sonar task
+typedef struct {
+	uint32_t echoWidth;
+	uint64_t echoTime;
+	uint8_t status;
+} SonarMeasurement;
+
+// fires the trigger pulse, and ends a measurement without echo
+TIMER_CALLBACK sonarTriggerTimer;
+TIMER_CALLBACK sonarTimeoutTimer;
+uint32_t sonarTimeout = SONAR_TIMEOUT_IN_MICROSECONDS;
+// measurement periods while the wheels move and while idle, and the current one
+uint32_t sonarMovingPeriod = SONAR_MOVING_PERIOD_IN_MICROSECONDS;
+uint32_t sonarIdlePeriod = SONAR_IDLE_PERIOD_IN_MICROSECONDS;
+volatile uint32_t sonarPeriod = SONAR_IDLE_PERIOD_IN_MICROSECONDS;
+
+volatile uint8_t sonarState = SONAR_IDLE;
+volatile uint64_t sonarEchoStart = 0;
+
+// latest measurement, written by interrupts, read with getSonarReading()
+volatile uint8_t sonarStatus = SONAR_NO_READING;
+volatile uint32_t sonarEchoWidth = 0;
+// time of the last echo, on the 64 bit clock of custom_timer
+volatile uint64_t sonarEchoTime = 0;
+volatile uint16_t sonarSequence = 0;
+
+// measurements for the sonar task, which filters them
+QueueHandle_t sonarMeasurements;
+
+// echo widths of the last measurements, and the filtered widths with their times, written by the sonar task
+uint32_t sonarHistory[SONAR_HISTORY];
+uint32_t sonarFilteredHistory[SONAR_HISTORY];
+uint64_t sonarFilteredTimes[SONAR_HISTORY];
+volatile uint8_t sonarHistoryIndex = 0;
+volatile uint8_t sonarHistoryCount = 0;
+
+void timeoutSonar(void *argument);
+
+/*!\brief Median of echo widths
  *
- *\details Module timer is initialized for sonar.
+ *\details Sorts a copy of the values, the upper median for an even count.
  */
-void initSonar(void) {
-	initialize_module_timer0();
+uint32_t medianOfEchoes(const uint32_t *values, int count) {
+	uint32_t sorted[SONAR_HISTORY];
+	uint32_t value;
+	int j;
+
+	for (int i = 0; i < count; i++) {
+		value = values[i];
+		for (j = i; j > 0 && sorted[j - 1] > value; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = value;
+	}
+	return sorted[count / 2];
 }
 
+/*!\brief Hampel filter of an echo width
+ *
+ *\details Returns the latest sample, or the median of the history if the sample is an outlier, refer
+ * SONAR_HAMPEL_ constants. The history includes the latest sample.
+ */
+uint32_t filterSonarEcho(const uint32_t *history, int count, uint32_t latest) {
+	uint32_t deviations[SONAR_HISTORY];
+	uint32_t median = medianOfEchoes(history, count);
+	uint32_t threshold;
 
-/*!\brief Return the distance of target
+	for (int i = 0; i < count; i++) {
+		deviations[i] = (history[i] > median) ? history[i] - median : median - history[i];
+	}
+	threshold = medianOfEchoes(deviations, count) * SONAR_HAMPEL_SCALE_NUMERATOR / SONAR_HAMPEL_SCALE_DENOMINATOR;
+	if (threshold < SONAR_HAMPEL_MIN_THRESHOLD) {
+		threshold = SONAR_HAMPEL_MIN_THRESHOLD;
+	}
+	if (((latest > median) ? latest - median : median - latest) > threshold) {
+		return median;
+	}
+	return latest;
+}
+
+/*!\brief End a measurement
  *
- *\details Returns the distance of target using sonar, where the distance is the distance of the echo * the speed in air and divided by 2
+ *\details Publishes the measurement and disables the pin change interrupt, called in ISR context.
+ * Only records the echo, the sonar task filters it, refer processSonarMeasurement(); a measurement is dropped
+ * if the queue is full, the history then misses it.
  */
-double getSonarDistance(void) {
+void endSonarMeasurement(uint8_t status, uint32_t echoWidth, uint64_t echoTime) {
+	SonarMeasurement measurement;
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+	PCMSK2 &= ~_BV(PCINT16);
+	timer_callback_stop(&sonarTimeoutTimer);
+	sonarState = SONAR_IDLE;
+
+	sonarStatus = status;
+	sonarEchoWidth = echoWidth;
+	sonarEchoTime = echoTime;
+	sonarSequence++;
+
+	measurement.status = status;
+	measurement.echoWidth = echoWidth;
+	measurement.echoTime = echoTime;
+	xQueueSendFromISR(sonarMeasurements, &measurement, &higherPriorityTaskWoken);
+	// the sonar task runs at the next tick, the ISR does not switch tasks
+}
+
+/*!\brief Process a sonar measurement
+ *
+ *\details Called by the sonar task, waits for the next measurement of the interrupts.
+ * Adds the measurement to the history, a measurement without echo as SONAR_NO_ECHO_WIDTH, and filters it;
+ * then checks for collision with the filtered range, and adds it to the range map.
+ * Returns 1 when a measurement was processed, 0 otherwise.
+ */
+int processSonarMeasurement(void) {
+	SonarMeasurement measurement;
+	SonarRange range;
+	uint32_t history[SONAR_HISTORY];
+	uint32_t width;
+	uint32_t filtered;
+	uint8_t count;
+
+	if (xQueueReceive(sonarMeasurements, &measurement, portMAX_DELAY) != pdTRUE) {
+		return 0;
+	}
+
+	// only this task writes the history, readers copy it in a critical section
+	width = (measurement.status == SONAR_ECHO) ? measurement.echoWidth : SONAR_NO_ECHO_WIDTH;
+	count = (sonarHistoryCount < SONAR_HISTORY) ? sonarHistoryCount + 1 : SONAR_HISTORY;
+	for (int i = 0; i < SONAR_HISTORY; i++) {
+		history[i] = sonarHistory[i];
+	}
+	history[sonarHistoryIndex] = width;
+	filtered = filterSonarEcho(history, count, width);
+
+	taskENTER_CRITICAL();
+	sonarHistory[sonarHistoryIndex] = width;
+	sonarHistoryCount = count;
+	sonarFilteredHistory[sonarHistoryIndex] = filtered;
+	sonarFilteredTimes[sonarHistoryIndex] = measurement.echoTime;
+	sonarHistoryIndex = (sonarHistoryIndex + 1) % SONAR_HISTORY;
+	taskEXIT_CRITICAL();
+
+	// collision check every measurement, whatever the behavior cycle
+	getSonarRange(&range);
+	brakeForCollision(range.valid, range.distance, range.rate);
+	updateRangeMap(getHeading(), range.valid, range.distance);
+	return 1;
+}
+
+/*!\brief Trigger a measurement
+ *
+ *\details Timer callback, in ISR context: sends the PING))) trigger pulse, then waits for the echo
+ * with the pin change interrupt, up to the timeout. A measurement still waiting is not interrupted.
+ * The period follows the wheels, moving or idle, from the next measurement.
+ */
+void triggerSonar(void *argument) {
+	uint32_t period = (getMovingDirection() != 0) ? sonarMovingPeriod : sonarIdlePeriod;
+
+	if (period != sonarPeriod) {
+		sonarPeriod = period;
+		timer_callback_start(&sonarTriggerTimer, period, period, triggerSonar, NULL, TIMER_CALLBACK_IN_ISR);
+	}
+	if (sonarState != SONAR_IDLE) {
+		return;
+	}
 
 	// make port output
-	DDRA |= 0b00000001;
+	DDRK |= _BV(DDK0);
 
 	// Give a short LOW pulse beforehand to ensure a clean HIGH pulse
-	// custom_timer does not support microsecond delays
-	// so use delay from AVR util
-	PORTA &= 0b11111110;
+	PORTK &= ~_BV(PORTK0);
 	_delay_us(2);
 
 	// typical T-out from PING))) documentation = 5us
-	PORTA |= 0b00000001;
+	PORTK |= _BV(PORTK0);
 	_delay_us(5);
-	PORTA &= 0b11111110;
+	PORTK &= ~_BV(PORTK0);
 
 	// make port input
-	DDRA &= 0b11111110;
+	DDRK &= ~_BV(DDK0);
 
-	// wait for signal go high, start time count
-	loop_until_bit_is_set(PINA, PINA0);
-	long echoStart = time_in_microseconds();
-	// wait for signal go back to low, stop time count
-	loop_until_bit_is_clear(PINA, PINA0);
-	long echoStop = time_in_microseconds();
+	// the echo starts after a hold-off of about 750us
+	sonarState = SONAR_WAIT_RISE;
+	PCIFR = _BV(PCIF2);
+	PCMSK2 |= _BV(PCINT16);
+	timer_callback_start(&sonarTimeoutTimer, sonarTimeout, 0, timeoutSonar, NULL, TIMER_CALLBACK_IN_ISR);
+}
 
-	long tIn = echoStop - echoStart;
+/*!\brief Sonar timeout
+ *
+ *\details Timer callback, in ISR context: the echo did not start or end in time.
+ */
+void timeoutSonar(void *argument) {
+	if (sonarState != SONAR_IDLE) {
+		endSonarMeasurement(SONAR_NO_ECHO, 0, time_in_microseconds_64());
+	}
+}
 
-	// sound speed in air = 340m/s = 0.034cm/us
-	// round-trip so divide by 2 to get distance
-	double distance = tIn * 0.034 / 2;
+/*!\brief Initialize the sonar module
+ *
+ *\details Module timer is initialized for sonar, and measurements are triggered in the background,
+ * refer setSonarRate(). The PING))) signal is on PK0 (A8), which has a pin
+ * change interrupt. Measurements are filtered by the sonar task, refer processSonarMeasurement().
+ */
+void initSonar(void) {
+	sonarMeasurements = xQueueCreate(SONAR_QUEUE_LENGTH, sizeof(SonarMeasurement));
+	initialize_module_timer0();
+
+	DDRK &= ~_BV(DDK0);
+	PORTK &= ~_BV(PORTK0);
+	PCMSK2 &= ~_BV(PCINT16);
+	PCICR |= _BV(PCIE2);
+
+	timer_callback_start(&sonarTriggerTimer, sonarPeriod, sonarPeriod, triggerSonar, NULL, TIMER_CALLBACK_IN_ISR);
+}
+
+/*!\brief Set the sonar sampling rate
+ *
+ *\details Measurement periods while the wheels move and while idle, in microseconds; a period is never
+ * shorter than the timeout plus the PING))) hold-off, so measurements do not overlap. Applies from the next
+ * measurement.
+ */
+void setSonarRate(uint32_t movingPeriod, uint32_t idlePeriod) {
+	taskENTER_CRITICAL();
+	sonarMovingPeriod = (movingPeriod > sonarTimeout + SONAR_HOLD_OFF_IN_MICROSECONDS) ?
+		movingPeriod : sonarTimeout + SONAR_HOLD_OFF_IN_MICROSECONDS;
+	sonarIdlePeriod = (idlePeriod > sonarTimeout + SONAR_HOLD_OFF_IN_MICROSECONDS) ?
+		idlePeriod : sonarTimeout + SONAR_HOLD_OFF_IN_MICROSECONDS;
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief Set the sonar timeout
+ *
+ *\details Longest time from the trigger to the end of the echo, a measurement without echo in time
+ * has status SONAR_NO_ECHO. Applies from the next measurement.
+ */
+void setSonarTimeout(uint32_t microseconds) {
+	taskENTER_CRITICAL();
+	sonarTimeout = microseconds;
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief Get the latest sonar reading
+ *
+ *\details Does not wait. Copies the latest measurement, distance is SONAR_NO_ECHO_DISTANCE without echo.
+ * Returns the status of the reading.
+ */
+int getSonarReading(SonarReading *reading) {
+	uint32_t echoWidth;
+
+	taskENTER_CRITICAL();
+	reading->status = sonarStatus;
+	reading->time = sonarEchoTime;
+	reading->sequence = sonarSequence;
+	echoWidth = sonarEchoWidth;
+	taskEXIT_CRITICAL();
+
+	reading->distance = (reading->status == SONAR_ECHO) ? echoWidth * SONAR_CM_PER_MICROSECOND : SONAR_NO_ECHO_DISTANCE;
+	return reading->status;
+}
+
+/*!\brief Get the filtered sonar range
+ *
+ *\details Does not wait. Filtered distance of the latest measurement, and its rate of change over the history
+ * in cm/s, negative when the target gets closer. Valid when most of the history has echoes and the latest
+ * measurement is recent; distance is SONAR_NO_ECHO_DISTANCE and rate 0 otherwise.
+ * Returns 1 if the range is valid, 0 otherwise.
+ */
+int getSonarRange(SonarRange *range) {
+	uint32_t filtered[SONAR_HISTORY];
+	uint64_t times[SONAR_HISTORY];
+	uint8_t index;
+	uint8_t count;
+	uint8_t echoes = 0;
+	uint32_t period;
+	uint8_t newest;
+	uint8_t oldest;
+
+	taskENTER_CRITICAL();
+	index = sonarHistoryIndex;
+	count = sonarHistoryCount;
+	period = sonarPeriod;
+	for (int i = 0; i < count; i++) {
+		filtered[i] = sonarFilteredHistory[i];
+		times[i] = sonarFilteredTimes[i];
+		if (sonarHistory[i] != SONAR_NO_ECHO_WIDTH) {
+			echoes++;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	range->distance = SONAR_NO_ECHO_DISTANCE;
+	range->rate = 0;
+	range->time = 0;
+	range->valid = 0;
+	if (count == 0) {
+		return 0;
+	}
+
+	// the ring is full once count is SONAR_HISTORY, the oldest entry is then the next to be written
+	newest = (index + SONAR_HISTORY - 1) % SONAR_HISTORY;
+	oldest = (count < SONAR_HISTORY) ? 0 : index;
+	range->time = times[newest];
+	if (echoes < SONAR_VALID_ECHOES || filtered[newest] == SONAR_NO_ECHO_WIDTH
+		|| time_in_microseconds_64() - times[newest] > (uint64_t) period * SONAR_STALE_PERIODS) {
+		return 0;
+	}
+
+	range->distance = filtered[newest] * SONAR_CM_PER_MICROSECOND;
+	if (times[newest] > times[oldest] && filtered[oldest] != SONAR_NO_ECHO_WIDTH) {
+		range->rate = ((double) filtered[newest] - (double) filtered[oldest]) * SONAR_CM_PER_MICROSECOND
+			* 1000000.0 / (double) (times[newest] - times[oldest]);
+	}
+	range->valid = 1;
+	return 1;
+}
+
+/*!\brief Return the distance of target
+ *
+ *\details Returns the filtered distance of target, where the distance is the duration of the echo * the speed in air and divided by 2.
+ * Does not wait for a measurement; SONAR_NO_ECHO_DISTANCE if the range is not valid, refer getSonarRange().
+ */
+double getSonarDistance(void) {
+	SonarRange range;
+
+	getSonarRange(&range);
+	return range.distance;
+}
+
+
+/*!\brief Return the time of the last distance
+ *
+ *\details Time in microseconds of the latest measurement, refer time_in_microseconds_64(); the start of the echo,
+ * or the timeout without echo
+ */
+uint64_t getSonarTime(void) {
+	uint64_t time;
+
+	taskENTER_CRITICAL();
+	time = sonarEchoTime;
+	taskEXIT_CRITICAL();
+	return time;
+}
+
+/*!\brief Sonar pin change ISR
+ *
+ *\details Times the echo pulse: the rising edge starts it, the falling edge ends the measurement.
+ * PCINT16 is the only pin change interrupt enabled on PCINT2.
+ */
+ISR(PCINT2_vect) {
+	uint64_t now = time_in_microseconds_64();
 
-	return distance;
+	if (PINK & _BV(PINK0)) {
+		if (sonarState == SONAR_WAIT_RISE) {
+			sonarEchoStart = now;
+			sonarState = SONAR_WAIT_FALL;
+		}
+	}
+	else if (sonarState == SONAR_WAIT_FALL) {
+		endSonarMeasurement(SONAR_ECHO, (uint32_t) (now - sonarEchoStart), sonarEchoStart);
+	}
 }
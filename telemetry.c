@@ -0,0 +1,98 @@
+/*
+ * telemetry.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file telemetry.c
+ *
+ * Module for binary telemetry frames, pushed to a collector over UDP
+ * by the task handling WiFi, and sent on request over HTTP or the console; the frames are built by telemetryFormat.c
+ ------------------------------------------------------------------*/
+
+#include "FreeRTOS.h"
+#include "include/wireless_interface.h"
+#include "include/custom_timer.h"
+#include "include/telemetry.h"
+
+uint16_t telemetryRobotId = 0;
+uint16_t telemetrySequence = 0;
+// frames sent on request have their own sequence, so they do not appear as gaps in the UDP stream
+uint16_t telemetryRequestSequence = 0;
+char *telemetryCollectorAddress;
+uint16_t telemetryCollectorPort = 0;
+TCP_SOCKET telemetrySocket = NO_ACTIVE_SOCKET;
+int telemetryRetryCount = 0;
+
+// local functions
+/*!\brief Open the UDP connection to the collector
+ *
+ *\details Use the first closed socket, the web server keeps its own.
+ * return int 1 if connected, 0 otherwise.
+ */
+int openTelemetry(void) {
+	for (TCP_SOCKET socket = 0; socket < MAX_SOCKET_NUMBER; socket++) {
+		if (gs_get_socket_status(socket) == SOCKET_STATUS_CLOSED) {
+			if (gs_open_udp_client(socket, telemetryCollectorAddress, telemetryCollectorPort) == SUCCESS) {
+				telemetrySocket = socket;
+				return 1;
+			}
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// ==============================================================
+/*!\brief Initialize this module
+ *
+ *\details Set robot id and collector, and connect to the collector.
+ * Call after the wireless connection is active.
+ * @param robotId Identifies the robot to the collector.
+ * @param collectorAddress IPv4 address of the collector, the string is not copied.
+ * @param collectorPort UDP port of the collector.
+ */
+void initTelemetry(uint16_t robotId, char *collectorAddress, uint16_t collectorPort) {
+	telemetryRobotId = robotId;
+	telemetryCollectorAddress = collectorAddress;
+	telemetryCollectorPort = collectorPort;
+	telemetrySequence = 0;
+	openTelemetry();
+}
+
+/*!\brief Encode a telemetry frame on request
+ *
+ *\details Build a frame of the sample for HTTP or console, with current time and the request sequence.
+ * @param frame Buffer of TELEMETRY_FRAME_SIZE bytes.
+ * return int Frame size in bytes.
+ */
+int encodeTelemetryFrame(uint8_t *frame, const TelemetrySample *sample) {
+	return buildTelemetryFrame(frame, telemetryRobotId, telemetryRequestSequence++, time_in_milliseconds(), sample);
+}
+
+/*!\brief Send a telemetry frame
+ *
+ *\details Send the sample to the collector as one datagram, with the next sequence number.
+ * If there is no connection, try to connect again every TELEMETRY_RETRY_CALLS calls;
+ * sequence numbers keep counting, so the collector sees the gap.
+ * Call only from the task handling WiFi.
+ */
+void sendTelemetry(const TelemetrySample *sample) {
+	uint8_t frame[TELEMETRY_FRAME_SIZE];
+
+	if (telemetrySocket == NO_ACTIVE_SOCKET) {
+		telemetryRetryCount++;
+		if (telemetryRetryCount < TELEMETRY_RETRY_CALLS || !openTelemetry()) {
+			if (telemetryRetryCount >= TELEMETRY_RETRY_CALLS) {
+				telemetryRetryCount = 0;
+			}
+			telemetrySequence++;
+			return;
+		}
+		telemetryRetryCount = 0;
+	}
+
+	buildTelemetryFrame(frame, telemetryRobotId, telemetrySequence, time_in_milliseconds(), sample);
+	gs_write_binary_data_to_socket(telemetrySocket, frame, TELEMETRY_FRAME_SIZE);
+	telemetrySequence++;
+}
@@ -0,0 +1,112 @@
+/*
+ * telemetryFormat.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file telemetryFormat.c
+ *
+ * Module for the telemetry frame layout, called by the telemetry module
+ * It does not touch any hardware, so host tools and tests build and check the same frames, refer include/telemetry.h
+ ------------------------------------------------------------------*/
+
+#include <util/crc16.h>
+#include "include/telemetry.h"
+
+// local functions
+/*!\brief Store a 16 bit value
+ *
+ *\details Store value in buffer, low byte first.
+ */
+void putTelemetry16(uint8_t *buffer, uint16_t value) {
+	buffer[0] = value & 0xFF;
+	buffer[1] = value >> 8;
+}
+
+/*!\brief Store a 32 bit value
+ *
+ *\details Store value in buffer, low byte first.
+ */
+void putTelemetry32(uint8_t *buffer, uint32_t value) {
+	putTelemetry16(buffer, value & 0xFFFF);
+	putTelemetry16(buffer + 2, value >> 16);
+}
+
+/*!\brief Convert to an unsigned 16 bit value
+ *
+ *\details Negative values become 0, values too large become 65535.
+ */
+uint16_t clampTelemetry16(double value) {
+	if (value <= 0) {
+		return 0;
+	}
+	if (value >= 65535) {
+		return 65535;
+	}
+	return (uint16_t) value;
+}
+
+/*!\brief Calculate the CRC of a frame
+ *
+ *\details CRC-16/XMODEM of version up to end of payload.
+ */
+uint16_t crcTelemetry(const uint8_t *frame, int length) {
+	uint16_t crc = 0;
+	for (int i = 1; i < length; i++) {
+		crc = _crc_xmodem_update(crc, frame[i]);
+	}
+	return crc;
+}
+
+// ==============================================================
+/*!\brief Build a telemetry frame
+ *
+ *\details Fill frame with header, sample payload and CRC, refer telemetry.h for the layout.
+ * Does not touch any hardware.
+ * @param frame Buffer of TELEMETRY_FRAME_SIZE bytes.
+ * return int Frame size in bytes.
+ */
+int buildTelemetryFrame(uint8_t *frame, uint16_t robotId, uint16_t sequence, uint32_t time, const TelemetrySample *sample) {
+	uint8_t *payload = frame + TELEMETRY_HEADER_SIZE;
+
+	frame[0] = TELEMETRY_SYNC;
+	frame[1] = TELEMETRY_VERSION;
+	frame[2] = TELEMETRY_TYPE_SAMPLE;
+	frame[3] = TELEMETRY_SAMPLE_SIZE;
+	putTelemetry16(frame + 4, robotId);
+	putTelemetry16(frame + 6, sequence);
+	putTelemetry32(frame + 8, time);
+
+	putTelemetry16(payload, clampTelemetry16(sample->distance * 100));
+	putTelemetry16(payload + 2, clampTelemetry16(sample->speed * 1000));
+	putTelemetry16(payload + 4, clampTelemetry16(sample->sonar * 10));
+	payload[6] = sample->command;
+	payload[7] = sample->state;
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		payload[8 + i] = sample->thermal[i];
+	}
+
+	putTelemetry16(payload + TELEMETRY_SAMPLE_SIZE, crcTelemetry(frame, TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_SIZE));
+	return TELEMETRY_FRAME_SIZE;
+}
+
+/*!\brief Check a received telemetry frame
+ *
+ *\details Check sync, version, length and CRC; the same check a consumer of the frames does.
+ * @param length Bytes available in frame.
+ * return int Frame size in bytes if valid, 0 otherwise.
+ */
+int checkTelemetryFrame(const uint8_t *frame, int length) {
+	if (length < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE || frame[0] != TELEMETRY_SYNC || frame[1] != TELEMETRY_VERSION) {
+		return 0;
+	}
+	int frameSize = TELEMETRY_HEADER_SIZE + frame[3] + TELEMETRY_CRC_SIZE;
+	if (length < frameSize) {
+		return 0;
+	}
+	uint16_t crc = frame[frameSize - 2] | (frame[frameSize - 1] << 8);
+	if (crc != crcTelemetry(frame, frameSize - TELEMETRY_CRC_SIZE)) {
+		return 0;
+	}
+	return frameSize;
+}
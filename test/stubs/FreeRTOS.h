@@ -0,0 +1,17 @@
+/*
+ * FreeRTOS.h
+ *
+ * Host stand-in for the FreeRTOS kernel header, for the host tests only; declares the types used by module
+ * headers, a test links its own stand-ins for the functions the module under test calls.
+ */
+
+#ifndef TEST_STUBS_FREERTOS_H_
+#define TEST_STUBS_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint16_t TickType_t;
+typedef int8_t BaseType_t;
+typedef uint8_t UBaseType_t;
+
+#endif /* TEST_STUBS_FREERTOS_H_ */
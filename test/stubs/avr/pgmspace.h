@@ -0,0 +1,15 @@
+/*
+ * pgmspace.h
+ *
+ * Host stand-in for <avr/pgmspace.h>, for the host tests only; program memory is ordinary memory on the host.
+ */
+
+#ifndef TEST_STUBS_AVR_PGMSPACE_H_
+#define TEST_STUBS_AVR_PGMSPACE_H_
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#endif /* TEST_STUBS_AVR_PGMSPACE_H_ */
@@ -0,0 +1,18 @@
+/*
+ * i2cMultiMaster.h
+ *
+ * Host stand-in for the FreeRTOS I2C driver header, for the host tests only; a test links its own stand-ins
+ * for the functions.
+ */
+
+#ifndef TEST_STUBS_I2CMULTIMASTER_H_
+#define TEST_STUBS_I2CMULTIMASTER_H_
+
+#include <stdint.h>
+
+void I2C_Master_Initialise(uint8_t address);
+void I2C_Master_Start_Transceiver_With_Data(uint8_t *message, uint8_t size);
+uint8_t I2C_Master_Get_Data_From_Transceiver(uint8_t *message, uint8_t size);
+uint8_t I2C_Transceiver_Busy(void);
+
+#endif /* TEST_STUBS_I2CMULTIMASTER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * task.h
+ *
+ * Host stand-in for the FreeRTOS task header, for the host tests only; there is a single thread on the host,
+ * so critical sections are empty.
+ */
+
+#ifndef TEST_STUBS_TASK_H_
+#define TEST_STUBS_TASK_H_
+
+#include "FreeRTOS.h"
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+void vTaskDelay(TickType_t ticks);
+
+#endif /* TEST_STUBS_TASK_H_ */
@@ -0,0 +1,15 @@
+/*
+ * usartserial.h
+ *
+ * Host stand-in for the FreeRTOS USART driver header, for the host tests only; declares the types used by
+ * module headers, no function is available.
+ */
+
+#ifndef TEST_STUBS_USARTSERIAL_H_
+#define TEST_STUBS_USARTSERIAL_H_
+
+#include <stdint.h>
+
+typedef enum { USART0_ID, USART1_ID, USART2_ID, USART3_ID } USART_ID;
+
+#endif /* TEST_STUBS_USARTSERIAL_H_ */
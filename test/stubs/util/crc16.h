@@ -0,0 +1,26 @@
+/*
+ * crc16.h
+ *
+ * Host stand-in for the avr-libc CRC header, for the host tests and tools only; the same CRC in C,
+ * as given in the avr-libc documentation.
+ */
+
+#ifndef TEST_STUBS_UTIL_CRC16_H_
+#define TEST_STUBS_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data) {
+	crc = crc ^ ((uint16_t) data << 8);
+	for (int i = 0; i < 8; i++) {
+		if (crc & 0x8000) {
+			crc = (crc << 1) ^ 0x1021;
+		}
+		else {
+			crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+#endif /* TEST_STUBS_UTIL_CRC16_H_ */
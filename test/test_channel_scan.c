@@ -0,0 +1,126 @@
+/*
+ * test_channel_scan.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file test_channel_scan.c
+ *
+ * Host test of the channel scan parser, refer wireless_channel_scan.c
+ * Canned AT+WS responses are fed line by line, as gs_get_channel_scan_response() does on the robot.
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -Wall -Itest/stubs -I. test/test_channel_scan.c wireless_channel_scan.c -o test_channel_scan
+ *   ./test_channel_scan
+ * The file is empty for the AVR build, so the robot project can keep it in its tree.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <stdio.h>
+#include <string.h>
+
+#include "include/wireless_interface.h"
+
+int failures = 0;
+
+#define CHECK(condition) checkCondition((condition), #condition, __LINE__)
+
+void checkCondition(int condition, const char *text, int line) {
+	if (!condition) {
+		printf("FAIL line %d: %s\n", line, text);
+		failures++;
+	}
+}
+
+/*!\brief Feed a response.
+ *
+ *\details Feeds the characters of a response to the scan line collection, and parses each complete line.
+ * Returns the number of lines parsed as network entries.
+ */
+int feedResponse(const char *response, CHANNEL_SCAN_RESULT *scanResult) {
+	char scanLine[MAX_TX_BUFFER] = "";
+	uint16_t scanLineIndex = 0;
+	int entries = 0;
+
+	for (; *response != '\0'; response++) {
+		if (*response == '\r' || *response == '\n') {
+			if (scanLineIndex > 0 && gs_parse_channel_scan_line(scanLine, scanResult) == SUCCESS) {
+				entries++;
+			}
+			scanLineIndex = 0;
+			scanLine[0] = '\0';
+		}
+		else {
+			gs_append_channel_scan_character(scanLine, &scanLineIndex, *response);
+		}
+	}
+	return entries;
+}
+
+void testResponse(void) {
+	CHANNEL_SCAN_RESULT scanResult;
+	const char *response =
+		"AT+WS\r\n"
+		"       BSSID              SSID                     Channel  Type  RSSI Security\r\n"
+		"00:1d:73:69:2b:a0,  Chico                     , 11,  INFRA , -52 , WPA2-PERSONAL\r\n"
+		"00:24:6c:01:02:03,  lab, guest                , 1,  INFRA , -70 , NONE\r\n"
+		"00:24:6c:01:02:04,  Office                    , 1,  INFRA , -40 , WPA2-PERSONAL\r\n"
+		"No.Of AP Found:3\r\n"
+		"OK\r\n";
+
+	gs_clear_channel_scan_result(&scanResult);
+	CHECK(feedResponse(response, &scanResult) == 3);
+	CHECK(scanResult.networks_found == 3);
+	CHECK(scanResult.neighbour_count[11] == 1);
+	CHECK(scanResult.neighbour_count[1] == 2);
+	CHECK(scanResult.neighbour_strength[1] == (100 - 70) + (100 - 40));
+	CHECK(scanResult.neighbour_count[6] == 0);
+	// channel 6 is furthest from both
+	CHECK(gs_select_least_congested_channel(&scanResult, WIRELESS_CHANNEL_11) == WIRELESS_CHANNEL_6);
+}
+
+void testLongLine(void) {
+	CHANNEL_SCAN_RESULT scanResult;
+	char response[3 * MAX_TX_BUFFER];
+	int length;
+
+	// SSID longer than the line buffer, the channel and RSSI at the end of the line must survive
+	length = sprintf(response, "00:1d:73:69:2b:a1,  ");
+	for (int i = 0; i < 2 * MAX_TX_BUFFER; i++) {
+		response[length++] = (i % 10 == 0) ? ',' : 'x';
+	}
+	sprintf(&response[length], ", 6,  INFRA , -60 , WPA2-PERSONAL\r\n");
+
+	gs_clear_channel_scan_result(&scanResult);
+	CHECK(feedResponse(response, &scanResult) == 1);
+	CHECK(scanResult.neighbour_count[6] == 1);
+	CHECK(scanResult.neighbour_strength[6] == 100 - 60);
+}
+
+void testInvalidLines(void) {
+	CHANNEL_SCAN_RESULT scanResult;
+
+	gs_clear_channel_scan_result(&scanResult);
+	CHECK(feedResponse("00:1d:73:69:2b:a0,  Chico , 14,  INFRA , -52 , NONE\r\n", &scanResult) == 0);
+	CHECK(feedResponse("00:1d:73:69:2b:a0,  Chico , 6,  INFRA , 52 , NONE\r\n", &scanResult) == 0);
+	CHECK(feedResponse("00:1d:73:69:2b:a0,  Chico , 6, -52\r\n", &scanResult) == 0);
+	CHECK(feedResponse("ERROR\r\n", &scanResult) == 0);
+	CHECK(scanResult.networks_found == 0);
+	// no neighbour, the default channel is kept
+	CHECK(gs_select_least_congested_channel(&scanResult, WIRELESS_CHANNEL_3) == WIRELESS_CHANNEL_3);
+}
+
+int main(void) {
+	testResponse();
+	testLongLine();
+	testInvalidLines();
+
+	if (failures > 0) {
+		printf("%d failed\n", failures);
+		return 1;
+	}
+	printf("channel scan: all passed\n");
+	return 0;
+}
+
+#endif /* __AVR__ */
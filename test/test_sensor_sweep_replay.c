@@ -0,0 +1,222 @@
+/*
+ * test_sensor_sweep_replay.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file test_sensor_sweep_replay.c
+ *
+ * Host replay of the sensor sweep, refer sensorSweep.c
+ * A heat source drifts around the robot; each step a synthetic frame is taken at the servo position, its heat
+ * bearing is estimated by thermalSensor.c as on the robot, and the sweep moves the sensor. The blind sweep, the
+ * coarse sweep alone as before the adaptive policy, is replayed on the same runs for comparison.
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -Wall -Itest/stubs -I. test/test_sensor_sweep_replay.c sensorSweep.c thermalSensor.c -o test_sensor_sweep_replay
+ *   ./test_sensor_sweep_replay
+ * The file is empty for the AVR build, so the robot project can keep it in its tree.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <stdio.h>
+
+#include "include/sensorSweep.h"
+#include "include/thermalSensor.h"
+#include "include/thermalPanorama.h"
+#include "include/motion.h"
+#include "i2cMultiMaster.h"
+#include "task.h"
+
+// runs, and sensor steps of a run, about 30 seconds at one step per behavior cycle
+#define REPLAY_RUNS 2000
+#define REPLAY_STEPS 120
+// steps before the hold is counted, so it measures tracking rather than acquisition
+#define REPLAY_HOLD_FROM 40
+// degrees from the sensor axis of a source in view and centered
+#define REPLAY_CENTERED_DEGREES 10.0
+// heat source: ambient, degrees above it at the core, half width of the core and of the edge in degrees
+#define REPLAY_AMBIENT 22
+#define REPLAY_HEAT 8.0
+#define REPLAY_CORE_DEGREES 5.0
+#define REPLAY_EDGE_DEGREES 10.0
+// drift of the source per step in degrees, turning back at the ends of its range
+#define REPLAY_DRIFT 0.5
+#define REPLAY_RANGE 85.0
+
+void estimateHeatBearing(ThermalFrame *frame);
+
+// stand-ins for the functions thermalSensor.c calls, only estimateHeatBearing() is replayed
+void I2C_Master_Initialise(uint8_t address) {
+}
+
+void I2C_Master_Start_Transceiver_With_Data(uint8_t *message, uint8_t size) {
+}
+
+uint8_t I2C_Master_Get_Data_From_Transceiver(uint8_t *message, uint8_t size) {
+	return 0;
+}
+
+uint8_t I2C_Transceiver_Busy(void) {
+	return 0;
+}
+
+void vTaskDelay(TickType_t ticks) {
+}
+
+unsigned long time_in_milliseconds(void) {
+	return 0;
+}
+
+uint16_t motion_servo_get_pulse_width(int deviceId) {
+	return INITIAL_PULSE_WIDTH_TICKS;
+}
+
+int getMovingDirection(void) {
+	return 0;
+}
+
+void updateThermalPanorama(const ThermalFrame *frame) {
+}
+
+// random numbers of the replay, a fixed linear congruential generator so the numbers do not depend on the C library
+uint32_t replaySeed = 1;
+
+int replayRandom(int range) {
+	replaySeed = replaySeed * 1103515245UL + 12345UL;
+	return (int) ((replaySeed >> 16) % range);
+}
+
+double absolute(double value) {
+	return (value < 0) ? -value : value;
+}
+
+/*!\brief Axis of the sensor.
+ *
+ *\details Bearing the sensor looks at from a servo position, in degrees, positive to the left.
+ */
+double sensorAxis(uint16_t position) {
+	return -((int) position - (int) INITIAL_PULSE_WIDTH_TICKS) * THERMAL_SERVO_DEGREES_PER_TICK;
+}
+
+/*!\brief Synthesize a frame.
+ *
+ *\details Pixels looking at the source core are REPLAY_HEAT above ambient, falling off over the edge, with a
+ * noise of 1 degree; pixel 1 on the right. The heat bearing of the frame is estimated as on the robot.
+ */
+void synthesizeFrame(ThermalFrame *frame, uint16_t position, double source) {
+	double pixelBearing;
+	double distance;
+	double heat;
+
+	frame->values[0] = REPLAY_AMBIENT;
+	frame->servoPosition = position;
+	for (int i = 1; i <= THERMAL_PIXELS; i++) {
+		pixelBearing = sensorAxis(position) + (i - (THERMAL_PIXELS + 1) / 2.0) * THERMAL_PIXEL_DEGREES;
+		distance = absolute(pixelBearing - source);
+		heat = 0;
+		if (distance < REPLAY_CORE_DEGREES) {
+			heat = REPLAY_HEAT;
+		}
+		else if (distance < REPLAY_EDGE_DEGREES) {
+			heat = REPLAY_HEAT * (REPLAY_EDGE_DEGREES - distance) / (REPLAY_EDGE_DEGREES - REPLAY_CORE_DEGREES);
+		}
+		frame->values[i] = (uint8_t) (REPLAY_AMBIENT + heat + replayRandom(3) - 1);
+	}
+	estimateHeatBearing(frame);
+}
+
+typedef struct {
+	// steps until the source was first centered, summed over the runs that centered it
+	long acquireSteps;
+	int acquired;
+	// steps the source was centered after REPLAY_HOLD_FROM
+	long holdSteps;
+} ReplayResult;
+
+/*!\brief Replay a run.
+ *
+ *\details Steps the sensor REPLAY_STEPS times from a servo position with a drifting source; adaptive replays
+ * stepSensorSweep() while driving, otherwise the blind coarse sweep.
+ */
+void replayRun(ReplayResult *result, int adaptive, uint16_t start, double source, double drift) {
+	SensorSweep sweep;
+	ThermalFrame frame;
+	uint16_t position = start;
+	int direction = 1;
+	int acquire = -1;
+	int centered;
+
+	initSensorSweep(&sweep, start);
+	for (int step = 0; step < REPLAY_STEPS; step++) {
+		source += drift;
+		if (source > REPLAY_RANGE || source < -REPLAY_RANGE) {
+			drift = -drift;
+		}
+		synthesizeFrame(&frame, position, source);
+
+		if (adaptive) {
+			position = stepSensorSweep(&sweep, 1, frame.confidence, frame.bearing / 10.0);
+		}
+		else {
+			position += SENSOR_SWEEP_COARSE_STEP * direction;
+			if (position >= SENSOR_SWEEP_MAX) {
+				position = SENSOR_SWEEP_MAX;
+				direction = -1;
+			}
+			if (position <= SENSOR_SWEEP_MIN) {
+				position = SENSOR_SWEEP_MIN;
+				direction = 1;
+			}
+		}
+
+		centered = absolute(sensorAxis(position) - source) < REPLAY_CENTERED_DEGREES;
+		if (acquire < 0 && centered) {
+			acquire = step;
+		}
+		if (step >= REPLAY_HOLD_FROM && centered) {
+			result->holdSteps++;
+		}
+	}
+	if (acquire >= 0) {
+		result->acquireSteps += acquire;
+		result->acquired++;
+	}
+}
+
+void printResult(const char *name, const ReplayResult *result) {
+	printf("%-9s centered after %.2f steps (%d of %d runs), held %.0f%%\n", name,
+		(double) result->acquireSteps / result->acquired, result->acquired, REPLAY_RUNS,
+		100.0 * result->holdSteps / ((long) REPLAY_RUNS * (REPLAY_STEPS - REPLAY_HOLD_FROM)));
+}
+
+int main(void) {
+	ReplayResult blind = {0, 0, 0};
+	ReplayResult adaptive = {0, 0, 0};
+	uint16_t start;
+	double source;
+	double drift;
+	uint32_t seed;
+
+	for (int run = 0; run < REPLAY_RUNS; run++) {
+		source = -80 + replayRandom(160);
+		drift = replayRandom(2) ? REPLAY_DRIFT : -REPLAY_DRIFT;
+		start = SENSOR_SWEEP_MIN + SENSOR_SWEEP_COARSE_STEP * replayRandom(11);
+		// both sweeps see the same noise
+		seed = replaySeed;
+		replayRun(&blind, 0, start, source, drift);
+		replaySeed = seed;
+		replayRun(&adaptive, 1, start, source, drift);
+	}
+
+	printResult("blind:", &blind);
+	printResult("adaptive:", &adaptive);
+	if (adaptive.acquired < blind.acquired || adaptive.holdSteps <= blind.holdSteps
+		|| adaptive.acquireSteps * blind.acquired > blind.acquireSteps * adaptive.acquired) {
+		printf("FAIL: the adaptive sweep does not beat the blind sweep\n");
+		return 1;
+	}
+	printf("sensor sweep replay: passed\n");
+	return 0;
+}
+
+#endif /* __AVR__ */
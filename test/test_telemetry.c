@@ -0,0 +1,206 @@
+/*
+ * test_telemetry.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file test_telemetry.c
+ *
+ * Host test of the telemetry frames, refer telemetryFormat.c and host/telemetry_host.c
+ * Frames built as the robot builds them are checked and decoded as the collector and the decoder do, down to
+ * the CSV, and the gap detection is fed the sequences of lost, late and restarted streams.
+ * Build and run from the repository root:
+ *   gcc -std=gnu99 -Wall -Itest/stubs -I. test/test_telemetry.c telemetryFormat.c host/telemetry_host.c -o test_telemetry
+ *   ./test_telemetry
+ * The file is empty for the AVR build, so the robot project can keep it in its tree.
+ ------------------------------------------------------------------*/
+
+#ifndef __AVR__
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host/telemetry_host.h"
+
+// local function of telemetryFormat.c
+uint16_t crcTelemetry(const uint8_t *frame, int length);
+
+int failures = 0;
+
+#define CHECK(condition) checkCondition((condition), #condition, __LINE__)
+
+void checkCondition(int condition, const char *text, int line) {
+	if (!condition) {
+		printf("FAIL line %d: %s\n", line, text);
+		failures++;
+	}
+}
+
+/*!\brief Track a record.
+ *
+ *\details Feeds a record of the robot with the sequence and time to the stream.
+ * Returns the result of trackTelemetryStream().
+ */
+int trackRecord(TelemetryStream *stream, uint16_t sequence, uint32_t time) {
+	TelemetryRecord record = {0};
+
+	record.robotId = stream->robotId;
+	record.sequence = sequence;
+	record.time = time;
+	return trackTelemetryStream(stream, &record);
+}
+
+/*!\brief Decode a capture.
+ *
+ *\details Feeds the bytes to decodeTelemetryCapture() as a file and returns the CSV it writes in csv.
+ * Returns the number of frames decoded.
+ */
+int decodeCapture(const uint8_t *capture, int length, char *csv, int csvSize) {
+	FILE *captureFile = tmpfile();
+	FILE *csvFile = tmpfile();
+	int frames;
+	int csvLength;
+
+	fwrite(capture, 1, length, captureFile);
+	rewind(captureFile);
+	frames = decodeTelemetryCapture(captureFile, csvFile);
+	rewind(csvFile);
+	csvLength = fread(csv, 1, csvSize - 1, csvFile);
+	csv[csvLength] = '\0';
+	fclose(captureFile);
+	fclose(csvFile);
+	return frames;
+}
+
+void testRoundTrip(void) {
+	TelemetrySample sample = {1.234, 0.25, 35.7, 2, 1, {24, 25, 26, 27, 28, 29, 30, 31, 40}};
+	uint8_t frame[TELEMETRY_FRAME_SIZE];
+	TelemetryRecord record;
+
+	CHECK(buildTelemetryFrame(frame, 7, 65535, 123456789, &sample) == TELEMETRY_FRAME_SIZE);
+	CHECK(checkTelemetryFrame(frame, TELEMETRY_FRAME_SIZE) == TELEMETRY_FRAME_SIZE);
+	CHECK(decodeTelemetryFrame(frame, TELEMETRY_FRAME_SIZE, &record) == TELEMETRY_FRAME_SIZE);
+	CHECK(record.robotId == 7);
+	CHECK(record.sequence == 65535);
+	CHECK(record.time == 123456789);
+	CHECK(record.distance == 123);
+	CHECK(record.speed == 250);
+	CHECK(record.sonar == 357);
+	CHECK(record.command == 2);
+	CHECK(record.state == 1);
+	for (int i = 0; i < TELEMETRY_THERMAL_PIXELS; i++) {
+		CHECK(record.thermal[i] == sample.thermal[i]);
+	}
+	// a frame cut short is not decoded
+	CHECK(!decodeTelemetryFrame(frame, TELEMETRY_FRAME_SIZE - 1, &record));
+}
+
+void testCrc(void) {
+	TelemetrySample sample = {0.5, 0.1, 20, 0, 0, {25}};
+	uint8_t frame[TELEMETRY_FRAME_SIZE];
+
+	// CRC-16/XMODEM check value
+	CHECK(crcTelemetry((const uint8_t *) "x123456789", 10) == 0x31C3);
+	buildTelemetryFrame(frame, 1, 2, 3, &sample);
+	for (int i = 1; i < TELEMETRY_FRAME_SIZE; i++) {
+		frame[i] ^= 0x10;
+		CHECK(checkTelemetryFrame(frame, TELEMETRY_FRAME_SIZE) == 0);
+		frame[i] ^= 0x10;
+	}
+	CHECK(checkTelemetryFrame(frame, TELEMETRY_FRAME_SIZE) == TELEMETRY_FRAME_SIZE);
+}
+
+void testCsv(void) {
+	TelemetrySample sample = {1.234, 0.25, 35.7, 2, 1, {24, 25, 26, 27, 28, 29, 30, 31, 40}};
+	uint8_t capture[3 * TELEMETRY_FRAME_SIZE + 8];
+	char csv[1024];
+	int length = 0;
+
+	// console text before the first frame, and a corrupted frame between two good ones
+	memcpy(capture, "\r\n> Z\r\n", 8);
+	length = 8;
+	length += buildTelemetryFrame(capture + length, 7, 10, 1000, &sample);
+	length += buildTelemetryFrame(capture + length, 7, 11, 2000, &sample);
+	capture[length - 5] ^= 0xFF;
+	length += buildTelemetryFrame(capture + length, 7, 12, 3000, &sample);
+
+	CHECK(decodeCapture(capture, length, csv, sizeof(csv)) == 2);
+	CHECK(strcmp(csv,
+		"robot,sequence,time_ms,distance_cm,speed_mm_s,sonar_mm,command,state,ambient_c,"
+		"pixel1_c,pixel2_c,pixel3_c,pixel4_c,pixel5_c,pixel6_c,pixel7_c,pixel8_c\n"
+		"7,10,1000,123,250,357,2,1,24,25,26,27,28,29,30,31,40\n"
+		"7,12,3000,123,250,357,2,1,24,25,26,27,28,29,30,31,40\n") == 0);
+
+	// a frame cut off at the end of the capture
+	CHECK(decodeCapture(capture + 8, TELEMETRY_FRAME_SIZE - 1, csv, sizeof(csv)) == 0);
+}
+
+void testClamp(void) {
+	TelemetrySample sample = {-0.5, 100, 7000, 0, 0, {0}};
+	uint8_t frame[TELEMETRY_FRAME_SIZE];
+	TelemetryRecord record;
+
+	buildTelemetryFrame(frame, 1, 0, 0, &sample);
+	CHECK(decodeTelemetryFrame(frame, TELEMETRY_FRAME_SIZE, &record));
+	CHECK(record.distance == 0);
+	CHECK(record.speed == 65535);
+	CHECK(record.sonar == 65535);
+}
+
+void testGaps(void) {
+	TelemetryStream stream;
+
+	initTelemetryStream(&stream, 3);
+	// the first record of a robot is not a gap, whatever its sequence
+	CHECK(trackRecord(&stream, 100, 100000) == 0);
+	CHECK(trackRecord(&stream, 101, 101000) == 0);
+	CHECK(trackRecord(&stream, 105, 105000) == 3);
+	CHECK(stream.missing == 3);
+
+	// across the wrap of the sequence
+	initTelemetryStream(&stream, 3);
+	trackRecord(&stream, 65534, 200000);
+	CHECK(trackRecord(&stream, 65535, 201000) == 0);
+	CHECK(trackRecord(&stream, 2, 204000) == 2);
+	CHECK(stream.received == 3);
+	CHECK(stream.missing == 2);
+	CHECK(stream.late == 0);
+}
+
+void testLateAndRestart(void) {
+	TelemetryStream stream;
+
+	initTelemetryStream(&stream, 4);
+	trackRecord(&stream, 500, 500000);
+	trackRecord(&stream, 502, 502000);
+	// 501 arrives after 502, and 502 twice
+	CHECK(trackRecord(&stream, 501, 501000) == -1);
+	CHECK(trackRecord(&stream, 502, 502000) == -1);
+	CHECK(trackRecord(&stream, 503, 503000) == 0);
+	CHECK(stream.late == 2);
+	CHECK(stream.missing == 1);
+	// the robot restarts, counting from 0 with its clock
+	CHECK(trackRecord(&stream, 0, 900) == 0);
+	CHECK(trackRecord(&stream, 1, 1900) == 0);
+	CHECK(stream.restarts == 1);
+	CHECK(stream.missing == 1);
+	CHECK(stream.received == 5);
+}
+
+int main(void) {
+	testRoundTrip();
+	testClamp();
+	testCrc();
+	testCsv();
+	testGaps();
+	testLateAndRestart();
+
+	if (failures > 0) {
+		printf("%d failed\n", failures);
+		return 1;
+	}
+	printf("telemetry: all passed\n");
+	return 0;
+}
+
+#endif /* __AVR__ */
@@ -0,0 +1,123 @@
+/*
+ * thermalPanorama.c
+ *
+ */
+
+/*-----------------------------------------------------------------
+ * \file thermalPanorama.c
+ *
+ * Module for the thermal panorama, called by thermal sensor and main Chico modules
+ * Each pixel of a frame is kept in the bin of its bearing from the robot front, so the sensor sweep builds up
+ * a strip of about 180 degrees, and the hottest direction is known without spinning the robot
+ ------------------------------------------------------------------*/
+
+#include <math.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "include/thermalPanorama.h"
+#include "include/motion.h"
+#include "include/custom_timer.h"
+#include "include/wheelControl.h"
+
+#define THERMAL_PANORAMA_BIN_DEGREES (THERMAL_PANORAMA_DEGREES / THERMAL_PANORAMA_BINS)
+
+// temperature and time in milliseconds of the last pixel of each bin, written by the thermal task
+uint8_t panoramaTemperatures[THERMAL_PANORAMA_BINS];
+unsigned long panoramaTimes[THERMAL_PANORAMA_BINS];
+uint8_t panoramaKnown[THERMAL_PANORAMA_BINS];
+// heading the bins were measured at
+double panoramaHeading = 0;
+
+/*!\brief Bearing of a bin.
+ *
+ *\details Angle from the robot front to the center of a bin, positive to the left.
+ */
+double bearingOfPanoramaBin(int bin) {
+	return (bin + 0.5) * THERMAL_PANORAMA_BIN_DEGREES - THERMAL_PANORAMA_DEGREES / 2;
+}
+
+/*!\brief Update the thermal panorama.
+ *
+ *\details Called by the thermal task with each frame; each pixel goes to the bin of its bearing, the servo angle
+ * of the frame plus the pixel offset, pixels out of the field are dropped. The bins are from the robot front, so
+ * they are forgotten when the robot turns by more than half a bin.
+ */
+void updateThermalPanorama(const ThermalFrame *frame) {
+	double heading = getHeading();
+	double turn = heading - panoramaHeading;
+	double servoBearing = -((int) frame->servoPosition - (int) INITIAL_PULSE_WIDTH_TICKS) * THERMAL_SERVO_DEGREES_PER_TICK;
+	double bearing;
+	unsigned long now = time_in_milliseconds();
+	int bin;
+
+	if (turn > 180) {
+		turn -= 360;
+	}
+	else if (turn <= -180) {
+		turn += 360;
+	}
+
+	taskENTER_CRITICAL();
+	if (fabs(turn) > THERMAL_PANORAMA_BIN_DEGREES / 2) {
+		for (bin = 0; bin < THERMAL_PANORAMA_BINS; bin++) {
+			panoramaKnown[bin] = 0;
+		}
+		panoramaHeading = heading;
+	}
+	for (int i = 1; i <= THERMAL_PIXELS; i++) {
+		// pixel 1 on the right, the center of the row is between pixels 4 and 5
+		bearing = servoBearing + (i - (THERMAL_PIXELS + 1) / 2.0) * THERMAL_PIXEL_DEGREES;
+		bin = (int) floor((bearing + THERMAL_PANORAMA_DEGREES / 2) / THERMAL_PANORAMA_BIN_DEGREES);
+		if (bin < 0 || bin >= THERMAL_PANORAMA_BINS) {
+			continue;
+		}
+		panoramaTemperatures[bin] = frame->values[i];
+		panoramaTimes[bin] = now;
+		panoramaKnown[bin] = 1;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief Get a bin of the thermal panorama.
+ *
+ *\details Temperature and age in milliseconds of the last pixel of a bin, bin 0 on the right.
+ * Returns 1 if the bin is known and not older than THERMAL_PANORAMA_MAX_AGE, 0 otherwise.
+ */
+int getThermalPanoramaBin(int bin, uint8_t *temperature, uint32_t *age) {
+	int known;
+
+	taskENTER_CRITICAL();
+	known = panoramaKnown[bin];
+	*temperature = panoramaTemperatures[bin];
+	*age = time_in_milliseconds() - panoramaTimes[bin];
+	taskEXIT_CRITICAL();
+	return known && *age <= THERMAL_PANORAMA_MAX_AGE;
+}
+
+/*!\brief Get the hottest direction.
+ *
+ *\details Bearing from the robot front in degrees, positive to the left, and temperature of the hottest bin that
+ * is known. The panorama has a fixed number of bins, so the time does not depend on the frames.
+ * Returns 1 if a bin is known, 0 otherwise.
+ */
+int getHottestDirection(double *bearing, uint8_t *temperature) {
+	uint8_t binTemperature;
+	uint32_t age;
+	int hottest = -1;
+
+	*temperature = 0;
+	for (int bin = 0; bin < THERMAL_PANORAMA_BINS; bin++) {
+		if (getThermalPanoramaBin(bin, &binTemperature, &age) && (hottest < 0 || binTemperature > *temperature)) {
+			*temperature = binTemperature;
+			hottest = bin;
+		}
+	}
+	if (hottest < 0) {
+		*bearing = 0;
+		return 0;
+	}
+	*bearing = bearingOfPanoramaBin(hottest);
+	return 1;
+}
@@ -9,51 +9,61 @@
  * \date 02/05/2017
  *
  * Module for handling thermal sensor, called by main Chico module
+ * Frames are acquired by the thermal task into a back buffer and swapped with the front buffer when complete,
+ * so consumers always read a whole frame without waiting on the bus
  ------------------------------------------------------------------*/
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "i2cMultiMaster.h"
+#include "include/thermalSensor.h"
+#include "include/thermalPanorama.h"
+#include "include/motion.h"
+#include "include/custom_timer.h"
+#include "include/wheelControl.h"
 
 /* I2C addresses */
-// 0xC0 as master and 0x01 as bearing
 // taken from the I2C example of freeRTOS Module Documentation
 #define I2C_MASTER      0xBA
 #define I2C_THERMAL_W   0xD0
 #define I2C_THERMAL_R   0xD1
-#define I2C_BEARING     0x00
 
-/* Sensors number */
-// just integers 1-9, not addresses
+/* TPA81 registers */
+// 1 ambient, 2-9 pixels 1-8; the register pointer increments after each byte read
 #define SENSOR_AMBIENT	0x01
-#define SENSOR_PIXEL1	0x02
-#define SENSOR_PIXEL2	0x03
-#define SENSOR_PIXEL3	0x04
-#define SENSOR_PIXEL4	0x05
-#define SENSOR_PIXEL5	0x06
-#define SENSOR_PIXEL6	0x07
-#define SENSOR_PIXEL7	0x08
-#define SENSOR_PIXEL8	0x09
-
-// Thermal array initializer
-uint8_t thermalSensors[9][2] = {
-	{I2C_THERMAL_W, SENSOR_AMBIENT},
-	{I2C_THERMAL_W, SENSOR_PIXEL1},
-	{I2C_THERMAL_W, SENSOR_PIXEL2},
-	{I2C_THERMAL_W, SENSOR_PIXEL3},
-	{I2C_THERMAL_W, SENSOR_PIXEL4},
-	{I2C_THERMAL_W, SENSOR_PIXEL5},
-	{I2C_THERMAL_W, SENSOR_PIXEL6},
-	{I2C_THERMAL_W, SENSOR_PIXEL7},
-	{I2C_THERMAL_W, SENSOR_PIXEL8}
-};
-
-// Result array for read temperatures
-uint8_t thermalValues[9][2];
-
-// I2C read initializer
-uint8_t thermalRead[2] = {I2C_THERMAL_R, I2C_BEARING};
-
-int temperatureSum = 0;
-int temperatureAvg = 0;
+
+// burst read message, the address byte then the values
+#define THERMAL_BURST_SIZE (THERMAL_VALUES + 1)
+
+// the I2C driver must hold a whole burst
+#if defined(I2C_BUFFER_SIZE) && I2C_BUFFER_SIZE < THERMAL_BURST_SIZE
+#error "I2C_BUFFER_SIZE is too small for the thermal burst read"
+#endif
+
+// I2C register select, the first register of the burst
+uint8_t thermalSelect[2] = {I2C_THERMAL_W, SENSOR_AMBIENT};
+
+// I2C burst read, the driver copies the values after the address byte
+uint8_t thermalBurst[THERMAL_BURST_SIZE] = {I2C_THERMAL_R};
+
+// front and back frames, consumers read the front one
+ThermalFrame thermalFrames[2];
+uint8_t thermalFront = 0;
+// set once the first frame is complete
+uint8_t thermalCaptured = 0;
+uint16_t thermalSequence = 0;
+
+// temporal filter and background of the pixels, in 1/256 degrees
+#define THERMAL_FIXED_ONE 256
+// smoothing of the pixel noise, a new frame weighs 1/2
+#define THERMAL_FILTER_WEIGHT 2
+// background learning, a new frame weighs 1/64, a time constant around 3 seconds at THERMAL_FRAME_PERIOD
+#define THERMAL_BACKGROUND_WEIGHT 64
+
+int32_t thermalFiltered[THERMAL_PIXELS];
+int32_t thermalBackground[THERMAL_PIXELS];
+uint16_t thermalLastServoPosition = 0;
 
 /*!\brief Initialize the thermal sensors.
  *
@@ -63,33 +73,175 @@ void initThermal(void) {
 	I2C_Master_Initialise(I2C_MASTER);
 }
 
-/*!\brief Read current temperatures from thermal sensors.
+/*!\brief Average of pixel values.
+ *
+ *\details Average of count values of a frame, starting at first.
+ */
+uint8_t averageOfFrame(const ThermalFrame *frame, int first, int count) {
+	int sum = 0;
+
+	for (int i = first; i < first + count; i++) {
+		sum += frame->values[i];
+	}
+	return sum / count;
+}
+
+/*!\brief Estimate the heat bearing of a frame.
  *
  *\details
- * - Go through each thermal temperature, request and read data from them through I2C,
- *   store the data in the result array.
- * - Calculate average temperature after data collecting.
- */
-void readTemperatures(void) {
-	temperatureSum = 0;
-
-	for (int i = 0; i < 9; i++) {
-		I2C_Master_Start_Transceiver_With_Data((thermalSensors[i]), 2);
-		I2C_Master_Start_Transceiver_With_Data(thermalRead, 2);
-		I2C_Master_Get_Data_From_Transceiver(thermalValues[i], 2);
-		temperatureSum += thermalValues[i][1];
+ * - Each pixel weighs its degrees above ambient plus THERMAL_BEARING_DELTA; the weighted centroid of the row
+ *   gives the heat direction to a fraction of a pixel from the sensor axis.
+ * - The servo angle of the frame is added, so the bearing is from the robot front, positive to the left
+ *   as the headings of the range map.
+ * - The confidence grows with the summed weight, full at THERMAL_BEARING_FULL_HEAT; it is halved when the
+ *   warmest pixel is at an end of the row, the heat may extend out of view.
+ */
+void estimateHeatBearing(ThermalFrame *frame) {
+	int weight;
+	int sum = 0;
+	int moment = 0;
+	int warmest = 1;
+	double bearing;
+
+	for (int i = 1; i <= THERMAL_PIXELS; i++) {
+		weight = frame->values[i] - frame->values[0] - THERMAL_BEARING_DELTA;
+		if (weight > 0) {
+			sum += weight;
+			moment += weight * i;
+		}
+		if (frame->values[i] > frame->values[warmest]) {
+			warmest = i;
+		}
+	}
+	if (sum == 0) {
+		frame->bearing = 0;
+		frame->confidence = 0;
+		return;
 	}
 
-	temperatureAvg = (int) temperatureSum / 9;
+	// pixel 1 on the right, the center of the row is between pixels 4 and 5
+	bearing = ((double) moment / sum - (THERMAL_PIXELS + 1) / 2.0) * THERMAL_PIXEL_DEGREES;
+	bearing -= ((int) frame->servoPosition - (int) INITIAL_PULSE_WIDTH_TICKS) * THERMAL_SERVO_DEGREES_PER_TICK;
+	frame->bearing = (int16_t) (bearing * 10);
+
+	frame->confidence = (sum >= THERMAL_BEARING_FULL_HEAT) ? 100 : sum * 100 / THERMAL_BEARING_FULL_HEAT;
+	if (warmest == 1 || warmest == THERMAL_PIXELS) {
+		frame->confidence /= 2;
+	}
 }
 
-/*!\brief Get calculated average temperature.
+/*!\brief Filter a thermal frame.
+ *
+ *\details
+ * - Smooth each pixel with an exponential moving average, and learn its background with a slower one,
+ *   so a warm object that stays in view, example a radiator, becomes background after a few seconds.
+ * - A pixel more than THERMAL_FOREGROUND_DELTA above its background is foreground; the motion score is
+ *   the sum of the foreground excess in degrees.
+ * - While the servo steps or the wheels turn the pixels look at another scene each frame, so the background
+ *   is reset to ambient and nothing is foreground.
+ *   Called before the swap, thermalCaptured is 0 for the first frame.
+ * - Compute the averages and the heat bearing of the frame once, for the getters.
+ */
+void filterThermalFrame(ThermalFrame *frame) {
+	int32_t pixel;
+	int32_t excess;
+
+	// the background starts from the first frame
+	frame->viewMoving = !thermalCaptured || frame->servoPosition != thermalLastServoPosition
+		|| getMovingDirection() != 0;
+	frame->foreground = 0;
+	frame->motion = 0;
+	thermalLastServoPosition = frame->servoPosition;
+
+	for (int i = 0; i < THERMAL_PIXELS; i++) {
+		pixel = (int32_t) frame->values[i + 1] * THERMAL_FIXED_ONE;
+		if (frame->viewMoving) {
+			thermalFiltered[i] = pixel;
+			thermalBackground[i] = (int32_t) frame->values[0] * THERMAL_FIXED_ONE;
+			continue;
+		}
+		thermalFiltered[i] += (pixel - thermalFiltered[i]) / THERMAL_FILTER_WEIGHT;
+		thermalBackground[i] += (thermalFiltered[i] - thermalBackground[i]) / THERMAL_BACKGROUND_WEIGHT;
+		excess = thermalFiltered[i] - thermalBackground[i];
+		if (excess > THERMAL_FOREGROUND_DELTA * THERMAL_FIXED_ONE) {
+			frame->foreground |= 1 << i;
+			frame->motion += excess / THERMAL_FIXED_ONE;
+		}
+	}
+
+	frame->average = averageOfFrame(frame, 0, THERMAL_VALUES);
+	frame->left = averageOfFrame(frame, 5, 4);
+	frame->right = averageOfFrame(frame, 1, 4);
+	frame->center = averageOfFrame(frame, 4, 2);
+	estimateHeatBearing(frame);
+}
+
+/*!\brief Acquire a thermal frame.
  *
  *\details
+ * - Select the ambient register once, then read ambient and the 8 pixels in one burst through I2C.
+ *   The transfer is driven by the TWI interrupt, the calling task sleeps until it is complete.
+ * - Stamp the back frame with the capture time and the servo position, the direction the pixels were looking at.
+ * - Update the pixel background and compute the aggregates of the frame, refer filterThermalFrame().
+ * - Swap the back frame with the front frame; after a failed transfer the front frame is kept.
+ * - Add the pixels of the frame to the thermal panorama.
+ * Called by the thermal task only, the only user of the I2C bus.
+ * return int 1 if a new frame is in front, 0 otherwise.
+ */
+int acquireThermalFrame(void) {
+	ThermalFrame *frame = &thermalFrames[thermalFront ^ 1];
+
+	frame->time = time_in_milliseconds();
+	frame->servoPosition = motion_servo_get_pulse_width(MOTION_SERVO_CENTER);
+
+	I2C_Master_Start_Transceiver_With_Data(thermalSelect, 2);
+	I2C_Master_Start_Transceiver_With_Data(thermalBurst, THERMAL_BURST_SIZE);
+	while (I2C_Transceiver_Busy()) {
+		vTaskDelay(1);
+	}
+	if (!I2C_Master_Get_Data_From_Transceiver(thermalBurst, THERMAL_BURST_SIZE)) {
+		return 0;
+	}
+
+	for (int i = 0; i < THERMAL_VALUES; i++) {
+		frame->values[i] = thermalBurst[i + 1];
+	}
+	frame->sequence = ++thermalSequence;
+	filterThermalFrame(frame);
+
+	taskENTER_CRITICAL();
+	thermalFront ^= 1;
+	thermalCaptured = 1;
+	taskEXIT_CRITICAL();
+
+	updateThermalPanorama(frame);
+	return 1;
+}
+
+/*!\brief Get the latest thermal frame.
+ *
+ *\details Copies the front frame, all values were read in the same transfer.
+ * @param frame Frame to fill.
+ * return int 1 if a frame was captured, 0 before the first frame, the values are 0 then.
+ */
+int getThermalFrame(ThermalFrame *frame) {
+	int captured;
+
+	taskENTER_CRITICAL();
+	*frame = thermalFrames[thermalFront];
+	captured = thermalCaptured;
+	taskEXIT_CRITICAL();
+	return captured;
+}
+
+/*!\brief Get calculated average temperature.
+ *
+ *\details Average of ambient and the 8 pixels of the latest frame, computed once per frame;
+ * the single byte getters read the front frame without a copy.
  * return int The average temperature.
  */
 int getTemperatureAvg(void) {
-	return temperatureAvg;
+	return thermalFrames[thermalFront].average;
 }
 
 /*!\brief Get read value from a specific sensor
@@ -99,7 +251,23 @@ int getTemperatureAvg(void) {
  * return int Temperature value read from the specific sensor.
  */
 int getSensorValue(int sensor) {
-	return thermalValues[sensor][1];
+	return thermalFrames[thermalFront].values[sensor];
+}
+
+/*!\brief Get servo position of the thermal values
+ *
+ *\details
+ * return uint16_t Servo pulse width when the latest frame was read.
+ */
+uint16_t getThermalServoPosition(void) {
+	uint16_t position = INITIAL_PULSE_WIDTH_TICKS;
+
+	taskENTER_CRITICAL();
+	if (thermalCaptured) {
+		position = thermalFrames[thermalFront].servoPosition;
+	}
+	taskEXIT_CRITICAL();
+	return position;
 }
 
 /*!\brief Get average value of left 4 thermal sensors
@@ -108,11 +276,7 @@ int getSensorValue(int sensor) {
  * return int Average temperature read from left 4 thermal sensors.
  */
 int getLeftAvg(void) {
-	int leftSum = 0;
-	for(int i = 5; i < 9; i++) {
-		leftSum += thermalValues[i][1];
-	}
-	return leftSum / 4;
+	return thermalFrames[thermalFront].left;
 }
 
 /*!\brief Get average value of right 4 thermal sensors
@@ -121,11 +285,7 @@ int getLeftAvg(void) {
  * return int Average temperature read from right 4 thermal sensors.
  */
 int getRightAvg(void) {
-	int rightSum = 0;
-	for(int i = 1; i < 5; i++) {
-		rightSum += thermalValues[i][1];
-	}
-	return rightSum / 4;
+	return thermalFrames[thermalFront].right;
 }
 
 /*!\brief Get average value of center 2 thermal sensors
@@ -134,20 +294,54 @@ int getRightAvg(void) {
  * return int Average temperature read from center 2 thermal sensors.
  */
 int getCenterAvg(void) {
-	return (thermalValues[4][1] + thermalValues[5][1]) / 2;
+	return thermalFrames[thermalFront].center;
+}
+
+/*!\brief Get the foreground heat of the latest frame
+ *
+ *\details
+ * @param motion Motion score, sum of the foreground excess in degrees.
+ * return uint8_t Foreground mask, bit 0 for pixel 1 to bit 7 for pixel 8; 0 while the view is moving.
+ */
+uint8_t getThermalForeground(uint16_t *motion) {
+	uint8_t foreground;
+
+	taskENTER_CRITICAL();
+	foreground = thermalFrames[thermalFront].foreground;
+	*motion = thermalFrames[thermalFront].motion;
+	taskEXIT_CRITICAL();
+	return foreground;
+}
+
+/*!\brief Get the heat bearing of the latest frame
+ *
+ *\details Refer estimateHeatBearing().
+ * @param bearing Bearing from the robot front in degrees, positive to the left.
+ * return int Confidence 0 to 100, 0 when no pixel is warm.
+ */
+int getHeatBearing(double *bearing) {
+	int confidence;
+
+	taskENTER_CRITICAL();
+	*bearing = thermalFrames[thermalFront].bearing / 10.0;
+	confidence = thermalFrames[thermalFront].confidence;
+	taskEXIT_CRITICAL();
+	return confidence;
 }
 
 /*!\brief detect if average value of pixel sensors is higher than ambient temperature
  * if true, than heat source is ahead
  *
- *\details
+ *\details While the view is still, the heat source must also be foreground, so a static warm object
+ * is no longer taken as a heat source once it is learned as background.
  * return int return 0 if false, return 1 if true
  */
 int closeToHeat(void) {
-	if (temperatureAvg > thermalValues[0][1] + 1) {
-		return 1;
-	}
-	else {
-		return 0;
-	}
+	int heat;
+
+	taskENTER_CRITICAL();
+	ThermalFrame *frame = &thermalFrames[thermalFront];
+	heat = frame->average > frame->values[0] + 1 && (frame->viewMoving || frame->foreground != 0);
+	taskEXIT_CRITICAL();
+	return heat;
 }
@@ -11,55 +11,173 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "include/motion.h"
+#include "include/custom_timer.h"
+#include "include/sensorSweep.h"
+#include "include/thermalSensor.h"
 
 #include <stdio.h>
 
-// the direction of spinning thermal sensor
-// ranges from 1100 ~ 4800
-int sensorSpinPosition = INITIAL_PULSE_WIDTH_TICKS;
-// when sensor spins to 4140, we call it an end
-// sensor start spinning to the other way
-int sensorReachesEnd = 0;
-
-uint32_t *tickCountLeft;
+// sensor sweep step, one behavior cycle
+#define SENSOR_STEP_PERIOD_IN_MICROSECONDS 250000UL
+
+// wheel pulse widths: full speed forward, half speed forward, and stopped (1.5ms / 500ns = 3000)
+#define LEFT_FORWARD_PULSE_WIDTH_TICKS 4660
+#define RIGHT_FORWARD_PULSE_WIDTH_TICKS MIN_PULSE_WIDTH_TICKS
+#define WHEEL_NEUTRAL_PULSE_WIDTH_TICKS 3000
+#define LEFT_SLOW_PULSE_WIDTH_TICKS ((LEFT_FORWARD_PULSE_WIDTH_TICKS + WHEEL_NEUTRAL_PULSE_WIDTH_TICKS) / 2)
+#define RIGHT_SLOW_PULSE_WIDTH_TICKS ((RIGHT_FORWARD_PULSE_WIDTH_TICKS + WHEEL_NEUTRAL_PULSE_WIDTH_TICKS) / 2)
+
+// collision brake, time to collision in seconds below which the wheels are slowed or stopped,
+// and factor of the time needed to release the brake
+#define COLLISION_SLOW_TIME 1.0
+#define COLLISION_STOP_TIME 0.5
+#define COLLISION_RELEASE_FACTOR 1.25
+// closest distance in cm to drive to, whatever the speed
+#define COLLISION_STOP_DISTANCE 10.0
+// forward speed in cm/s at full speed, around 1 meter in 6 behavior cycles
+#define FORWARD_SPEED 68.0
+
+// travel of a wheel per encoder spin unit in cm, and heading change per spin unit while spinning in place,
+// the travel over the wheel base of about 10.5 cm: 0.54 / 10.5 rad
+#define WHEEL_TRAVEL_PER_UNIT 0.54
+#define SPIN_DEGREES_PER_UNIT 2.95
+
+// sweep of the thermal sensor, positions range from 1100 ~ 4800
+SensorSweep sensorSweep;
+// marks a sensor step due every behavior cycle, the step itself runs in the thermal task, refer updateSensorSweep()
+TIMER_CALLBACK sensorStepTimer;
+volatile uint8_t sensorStepDue = 0;
+// set by resetSensorPosition(), the sweep is restarted by the next updateSensorSweep()
+volatile uint8_t sensorSweepReset = 0;
+
+uint32_t tickCountLeft;
+// time the last encoder tick was detected, on the 64 bit clock of custom_timer
+uint64_t leftWheelEventTime = 0;
 double leftWheelTime = 0;
 double leftWheelSpeed = 0;
 double leftWheelDistance = 0;
 
-uint32_t *tickCountRight;
+uint32_t tickCountRight;
+uint64_t rightWheelEventTime = 0;
 double rightWheelTime = 0;
 double rightWheelSpeed = 0;
 double rightWheelDistance = 0;
 
+// heading in degrees from power-on, 0 to 360 counter-clockwise, from encoder spin units while spinning
+double heading = 0;
+void countTravel(void);
+void turnHeading(uint16_t units);
+
 // idle = 0
 // forward = 1
 // backward = 2
 // spin left = 3
 // spin right = 4
-int movingDirection = 0;
+// read by the sensor sweep in the thermal task
+volatile int movingDirection = 0;
+
+// collision brake level, set by the sonar task: 0 released, 1 slow, 2 stop
+volatile uint8_t collisionBrake = 0;
+uint16_t collisionBrakeCount = 0;
 
 // local function
 /*!\brief reset the sensor
  *
- *\details position of thermal sensor is reset to center position
+ *\details position of thermal sensor is reset to center position, the sweep restarts from there on the next
+ * updateSensorSweep()
  */
 void resetSensorPosition(void) {
 	motion_servo_start(MOTION_SERVO_CENTER);
+	taskENTER_CRITICAL();
+	sensorSweepReset = 1;
 	motion_servo_set_pulse_width(MOTION_SERVO_CENTER, INITIAL_PULSE_WIDTH_TICKS);
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief step the sensor
+ *
+ *\details Timer callback, in ISR context: only marks a step due, the soft float of the sweep and the
+ * 16 bit servo register are left to updateSensorSweep().
+ */
+void stepSensor(void *argument) {
+	sensorStepDue = 1;
+}
+
+/*!\brief update the sensor sweep
+ *
+ *\details Called by the thermal task after each frame, the only writer of the sweep: restarts it after
+ * resetSensorPosition(), and moves the thermal sensor one step when stepSensor() marked one due, refer
+ * stepSensorSweep(). The coarse sweep runs while the robot moves forward or backward; a heat source found is
+ * tracked in every state. A reset during the step wins, the sensor stays at the center.
+ */
+void updateSensorSweep(void) {
+	double bearing;
+	int confidence;
+	// when the robot is not moving, do not spin
+	int coarse = (movingDirection == 1 || movingDirection == 2);
+	uint16_t position;
+
+	taskENTER_CRITICAL();
+	if (sensorSweepReset) {
+		sensorSweepReset = 0;
+		initSensorSweep(&sensorSweep, INITIAL_PULSE_WIDTH_TICKS);
+	}
+	taskEXIT_CRITICAL();
+	if (!sensorStepDue) {
+		return;
+	}
+	sensorStepDue = 0;
+
+	confidence = getHeatBearing(&bearing);
+	position = sensorSweep.position;
+	if (stepSensorSweep(&sensorSweep, coarse, confidence, bearing) != position) {
+		taskENTER_CRITICAL();
+		if (!sensorSweepReset) {
+			motion_servo_set_pulse_width(MOTION_SERVO_CENTER, sensorSweep.position);
+		}
+		taskEXIT_CRITICAL();
+	}
+}
+
+/*!\brief set forward pulse widths
+ *
+ *\details set the wheel pulse widths of forward motion for a collision brake level
+ */
+void setForwardPulseWidths(uint8_t brake) {
+	if (brake == 2) {
+		motion_servo_set_pulse_width(MOTION_WHEEL_LEFT, WHEEL_NEUTRAL_PULSE_WIDTH_TICKS);
+		motion_servo_set_pulse_width(MOTION_WHEEL_RIGHT, WHEEL_NEUTRAL_PULSE_WIDTH_TICKS);
+	}
+	else if (brake == 1) {
+		motion_servo_set_pulse_width(MOTION_WHEEL_LEFT, LEFT_SLOW_PULSE_WIDTH_TICKS);
+		motion_servo_set_pulse_width(MOTION_WHEEL_RIGHT, RIGHT_SLOW_PULSE_WIDTH_TICKS);
+	}
+	else {
+		// left wheel turns counter-clockwise
+		// 2.33ms / 500ns = 4660
+		motion_servo_set_pulse_width(MOTION_WHEEL_LEFT, LEFT_FORWARD_PULSE_WIDTH_TICKS);
+		// right wheel turns clockwise
+		// 0.55 / 500ns = 1100
+		motion_servo_set_pulse_width(MOTION_WHEEL_RIGHT, RIGHT_FORWARD_PULSE_WIDTH_TICKS);
+	}
 }
 
 // ==============================================================
 /*!\brief Initialize this module
  *
- *\details Initialize the motion servo by calling the init function of motion.c
+ *\details Initialize the motion servo by calling the init function of motion.c, and mark a sensor step due
+ * every 250 ms, refer updateSensorSweep(); custom timer must be initialized first.
  */
 void initMotion(void) {
 	motion_init();
+	initSensorSweep(&sensorSweep, INITIAL_PULSE_WIDTH_TICKS);
+	timer_callback_start(&sensorStepTimer, SENSOR_STEP_PERIOD_IN_MICROSECONDS, SENSOR_STEP_PERIOD_IN_MICROSECONDS,
+			stepSensor, NULL, TIMER_CALLBACK_IN_ISR);
 }
 
 /*!\brief spin sensor
  *
- *\details thermal sensor spins when robot is moving
+ *\details thermal sensor spins when robot is moving, stepped by updateSensorSweep(); waits for the behavior cycle
  */
 void spinSensor(void) {
 	TickType_t xLastWakeTime;
@@ -67,51 +185,26 @@ void spinSensor(void) {
 
 	motion_servo_start(MOTION_SERVO_CENTER);
 
-	// when the robot is not moving, do not spin
-	if(movingDirection == 1 || movingDirection == 2) {
-		motion_servo_set_pulse_width(MOTION_SERVO_CENTER, sensorSpinPosition);
-
-		// sensor rotate from left to right and back
-		// 1100 min
-		// 1140 1440 1740 2040 2340
-		// 2640 Initial
-		// 2940 3240 3540 3840 4140
-		// 4800 max
-		if (sensorReachesEnd == 0) {
-			sensorSpinPosition += 300;
-			if (sensorSpinPosition >= 4140) {
-				sensorReachesEnd = 1;
-			}
-		} else {
-			sensorSpinPosition -= 300;
-			if (sensorSpinPosition <= 1140) {
-				sensorReachesEnd = 0;
-			}
-		}
-	}
-
 	vTaskDelayUntil(&xLastWakeTime, (250 / portTICK_PERIOD_MS));
 }
 
 /*!\brief move forward
  *
- *\details start servomotor for left and right wheel
+ *\details start servomotor for left and right wheel, slowed or stopped by the collision brake
  */
 void moveForward(void) {
 	TickType_t xLastWakeTime;
 	xLastWakeTime = xTaskGetTickCount();
 
-	movingDirection = 1;
-
 	motion_servo_start(MOTION_WHEEL_LEFT);
 	motion_servo_start(MOTION_WHEEL_RIGHT);
 
-	// left wheel turns counter-clockwise
-	// 2.33ms / 500ns = 4660
-	motion_servo_set_pulse_width(MOTION_WHEEL_LEFT, 4660);
-	// right wheel turns clockwise
-	// 0.55 / 500ns = 1100
-	motion_servo_set_pulse_width(MOTION_WHEEL_RIGHT, MIN_PULSE_WIDTH_TICKS);
+	// the collision brake holds while an obstacle is close
+	taskENTER_CRITICAL();
+	countTravel();
+	movingDirection = 1;
+	setForwardPulseWidths(collisionBrake);
+	taskEXIT_CRITICAL();
 
 	vTaskDelayUntil(&xLastWakeTime, (250 / portTICK_PERIOD_MS));
 }
@@ -124,7 +217,10 @@ void moveBackward(void) {
 	TickType_t xLastWakeTime;
 	xLastWakeTime = xTaskGetTickCount();
 
+	taskENTER_CRITICAL();
+	countTravel();
 	movingDirection = 2;
+	taskEXIT_CRITICAL();
 
 	motion_servo_start(MOTION_WHEEL_LEFT);
 	motion_servo_start(MOTION_WHEEL_RIGHT);
@@ -145,7 +241,10 @@ void spinLeft(void) {
 	TickType_t xLastWakeTime;
 	xLastWakeTime = xTaskGetTickCount();
 
+	taskENTER_CRITICAL();
+	countTravel();
 	movingDirection = 3;
+	taskEXIT_CRITICAL();
 
 	motion_servo_start(MOTION_WHEEL_LEFT);
 	motion_servo_start(MOTION_WHEEL_RIGHT);
@@ -165,7 +264,10 @@ void spinRight(void) {
 	TickType_t xLastWakeTime;
 	xLastWakeTime = xTaskGetTickCount();
 
+	taskENTER_CRITICAL();
+	countTravel();
 	movingDirection = 4;
+	taskEXIT_CRITICAL();
 
 	motion_servo_start(MOTION_WHEEL_LEFT);
 	motion_servo_start(MOTION_WHEEL_RIGHT);
@@ -179,35 +281,184 @@ void spinRight(void) {
 
 /*!\brief stop movement
  *
- *\details stops servomotor for left and right wheel, reset position of sensor
+ *\details stops servomotor for left and right wheel, reset position of sensor unless it tracks a heat source
  */
 void stopMotion(void) {
 	// since this function will be repetitively called
 	// change direction after stopping servos make sure we only stop once
 	if(movingDirection != 0) {
-		resetSensorPosition();
+		if (sensorSweep.mode != SENSOR_SWEEP_TRACK) {
+			resetSensorPosition();
+		}
 		motion_servo_stop(MOTION_SERVO_CENTER);
 		motion_servo_stop(MOTION_WHEEL_RIGHT);
 		motion_servo_stop(MOTION_WHEEL_LEFT);
 	}
 
+	taskENTER_CRITICAL();
+	countTravel();
 	movingDirection = 0;
+	taskEXIT_CRITICAL();
 }
 
 /*!\brief update time and distance
  *
- *\details adds up the distance and updates time for each spin unit detected
+ *\details updates time with the period of the latest spin unit and timestamps it, and adds up the distance
+ * and heading of the spin units counted since the last call, within the period of the caller
  */
 void updateTimeDistance(void) {
-	// add distance & update time for each spin unit detected
-	if (motion_enc_read(MOTION_WHEEL_LEFT, tickCountLeft) == 1) {
-		leftWheelTime = (tickCountLeft[0] * 0.0000005); // 2MHz; 500ns
-		leftWheelDistance += 0.54;
+	// update time for the latest spin unit detected
+	if (motion_enc_read(MOTION_WHEEL_LEFT, &tickCountLeft) == 1) {
+		leftWheelTime = (tickCountLeft * 0.0000005); // 2MHz; 500ns
+		leftWheelEventTime = time_in_microseconds_64();
+	}
+	if (motion_enc_read(MOTION_WHEEL_RIGHT, &tickCountRight) == 1) {
+		rightWheelTime = (tickCountRight * 0.0000005);
+		rightWheelEventTime = time_in_microseconds_64();
+	}
+
+	taskENTER_CRITICAL();
+	countTravel();
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief count travel
+ *
+ *\details adds the spin units counted since the last call to the distance of each wheel and to the heading,
+ * in the direction they were driven; several units can pass between two calls. Called in a critical section,
+ * before each change of the moving direction so that no unit is credited to the next one.
+ */
+void countTravel(void) {
+	uint16_t units;
+
+	units = motion_enc_count(MOTION_WHEEL_LEFT);
+	leftWheelDistance += units * WHEEL_TRAVEL_PER_UNIT;
+	turnHeading(units);
+	units = motion_enc_count(MOTION_WHEEL_RIGHT);
+	rightWheelDistance += units * WHEEL_TRAVEL_PER_UNIT;
+	turnHeading(units);
+}
+
+/*!\brief turn the heading
+ *
+ *\details each spin unit of a wheel while spinning in place turns the heading, left counter-clockwise; encoders do
+ * not tell the direction, so it is taken from the spin command. Forward and backward moves keep the heading.
+ * Called in a critical section, the heading is read by the sonar task.
+ */
+void turnHeading(uint16_t units) {
+	double turn = 0;
+
+	if (units == 0) {
+		return;
+	}
+	if (movingDirection == 3) {
+		turn = units * SPIN_DEGREES_PER_UNIT;
+	}
+	else if (movingDirection == 4) {
+		turn = -(units * SPIN_DEGREES_PER_UNIT);
+	}
+	else {
+		return;
+	}
+	heading += turn;
+	while (heading >= 360) {
+		heading -= 360;
+	}
+	while (heading < 0) {
+		heading += 360;
 	}
-	if (motion_enc_read(MOTION_WHEEL_RIGHT, tickCountRight) == 1) {
-		rightWheelTime = (tickCountRight[0] * 0.0000005);
-		rightWheelDistance += 0.54;
+}
+
+/*!\brief heading
+ *
+ *\details return the heading in degrees from power-on, 0 to 360 counter-clockwise; can be called from an ISR
+ */
+double getHeading(void) {
+	double value;
+
+	taskENTER_CRITICAL();
+	value = heading;
+	taskEXIT_CRITICAL();
+	return value;
+}
+
+/*!\brief time of the last encoder tick
+ *
+ *\details return the time in microseconds the last spin unit of a wheel was detected, refer time_in_microseconds_64()
+ */
+uint64_t getWheelEventTime(int wheel) {
+	if (wheel == MOTION_WHEEL_LEFT) {
+		return leftWheelEventTime;
 	}
+	return rightWheelEventTime;
+}
+
+/*!\brief collision brake
+ *
+ *\details Called by the sonar task after each measurement, so the robot reacts within a sonar period and a tick,
+ * whatever the behavior cycle. Time to collision is the distance over the closing speed, the commanded
+ * forward speed or the measured rate of the range if faster. While moving forward, slows the wheels
+ * below COLLISION_SLOW_TIME and stops them below COLLISION_STOP_TIME or COLLISION_STOP_DISTANCE; the
+ * brake is released when the time to collision is COLLISION_RELEASE_FACTOR above the threshold, or
+ * there is no valid range. moveForward() keeps the brake level.
+ */
+void brakeForCollision(int valid, double distance, double rate) {
+	double closingSpeed = (-rate > FORWARD_SPEED) ? -rate : FORWARD_SPEED;
+	double timeToCollision = distance / closingSpeed;
+	uint8_t brake = 0;
+
+	if (valid) {
+		if (distance < COLLISION_STOP_DISTANCE || timeToCollision < COLLISION_STOP_TIME) {
+			brake = 2;
+		}
+		else if (timeToCollision < COLLISION_SLOW_TIME) {
+			brake = 1;
+		}
+		// hysteresis, so the wheels do not chatter around a threshold
+		if (brake < collisionBrake) {
+			if (collisionBrake == 2 && distance < COLLISION_STOP_DISTANCE * COLLISION_RELEASE_FACTOR) {
+				brake = 2;
+			}
+			else if (timeToCollision < ((collisionBrake == 2) ? COLLISION_STOP_TIME : COLLISION_SLOW_TIME)
+				* COLLISION_RELEASE_FACTOR) {
+				brake = collisionBrake;
+			}
+		}
+	}
+
+	// moveForward() sets the wheels from the brake level in a critical section too
+	taskENTER_CRITICAL();
+	if (brake > collisionBrake) {
+		collisionBrakeCount++;
+	}
+	if (brake != collisionBrake) {
+		collisionBrake = brake;
+		if (movingDirection == 1) {
+			setForwardPulseWidths(brake);
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*!\brief collision brake level
+ *
+ *\details return the collision brake level, 0 released, 1 slow, 2 stop; and the number of times it was applied
+ * or raised
+ */
+int getCollisionBrake(uint16_t *count) {
+	taskENTER_CRITICAL();
+	*count = collisionBrakeCount;
+	taskEXIT_CRITICAL();
+	return collisionBrake;
+}
+
+/*!\brief moving direction
+ *
+ *\details return the direction the wheels are driven: 0 idle, 1 forward, 2 backward, 3 spin left, 4 spin right;
+ * can be called from an ISR
+ */
+int getMovingDirection(void) {
+	return movingDirection;
 }
 
 /*!\brief average speed
@@ -230,7 +481,13 @@ double getAvgSpeed(void) {
  *
  */
 double getDistance(void) {
+	double sum;
+
+	// added up in a critical section by the speed monitor and the motion commands
+	taskENTER_CRITICAL();
+	sum = leftWheelDistance + rightWheelDistance;
+	taskEXIT_CRITICAL();
 	// sum distance divided by 2 x 100 (convert from cm to m)
-	return (leftWheelDistance + rightWheelDistance) / 200;
+	return sum / 200;
 }
 /*!@}*/
@@ -0,0 +1,244 @@
+/*
+ * wireless_channel_scan.c
+ *
+ */
+
+/****************************************************************************//*!
+ * \ingroup wireless_interface
+ * @{
+******************************************************************************/
+
+
+
+/******************************************************************************************************************/
+/* CODING STANDARDS:
+ * Program file: Section I. Prologue: description about the file, description author(s), revision control
+ * 				information, references, etc.
+ */
+
+/*(Doxygen help: use \brief to provide short summary and \details command can be used)*/
+
+/*!	\file wireless_channel_scan.c
+ * 	\brief This file implements parsing and scoring of the Gainspan GS1011M network scan (AT+WS), used to select
+ * 	the least congested channel for Limited AP.
+ *
+ *
+ * \details Functions in this file do not access the module or the USART, so canned scan responses can be fed to
+ * them on the host, refer test/test_channel_scan.c. Collection of the response is in wireless_interface.c.
+ *
+ */
+/******************************************************************************************************************/
+
+
+
+/******************************************************************************************************************/
+/* CODING STANDARDS:
+ * Program file: Section II. Include(s): header file includes. System include files and then user include files.
+ * 				Ensure to add comments for an inclusion which is not very obvious. Suggested order of inclusion is
+ * 								System -> Other Modules -> Same Module -> Specific to this file
+ * Note: Avoid nested inclusions.
+ */
+
+/* --Includes-- */
+#include <string.h>
+#include <stdlib.h>
+
+/* module includes */
+#include "include/wireless_interface.h"				/* module include */
+/******************************************************************************************************************/
+
+
+
+/******************************************************************************************************************/
+/* CODING STANDARDS:
+ * Program file: Section V. Functions: functions are declared in include/wireless_interface.h, and defined in the
+ * 				same order as of declaration.
+ */
+
+/*!
+ * \brief Clear channel scan result.
+ *
+ *
+ * \details Initializes neighbour count and strength of all channels to zero.
+ *
+ *
+ * @param scan_result - channel scan result to clear.
+ *
+ */
+void gs_clear_channel_scan_result(CHANNEL_SCAN_RESULT *scan_result){
+	memset(scan_result, 0, sizeof(CHANNEL_SCAN_RESULT));
+}
+
+
+/*!
+ * \brief Append a character to a line of the scan response.
+ *
+ *
+ * \details Adds a character to the line being collected, and keeps the line terminated. A line longer than
+ * MAX_TX_BUFFER - 1 characters loses its beginning rather than its end, as fields are located from the end of the
+ * line, refer gs_parse_channel_scan_line().
+ *
+ *
+ * @param scan_line - line being collected, MAX_TX_BUFFER characters.
+ * @param scan_line_index - number of characters in the line, updated.
+ * @param character - character to append, not a line termination.
+ * @return - 1 if the beginning of the line was dropped, else 0.
+ *
+ */
+uint8_t gs_append_channel_scan_character(char *scan_line, uint16_t *scan_line_index, char character){
+	uint8_t line_truncated = 0;
+
+	if(*scan_line_index >= (MAX_TX_BUFFER - 1)){
+		memmove(scan_line, &scan_line[1], MAX_TX_BUFFER - 2);
+		*scan_line_index = MAX_TX_BUFFER - 2;
+		line_truncated = 1;
+	}
+	scan_line[*scan_line_index] = character;
+	(*scan_line_index)++;
+	scan_line[*scan_line_index] = '\0';
+
+	return line_truncated;
+}
+
+
+/*!
+ * \brief Parse a line of the scan response from Gainspan WiFi module.
+ *
+ *
+ * \details Parses one network entry of the AT+WS response and adds it to the scan result. An entry is of the form:
+ *
+ * 		BSSID, SSID, Channel, Type, RSSI, Security
+ *
+ * 		Example: 00:1d:73:69:2b:a0,  Chico                     , 11,  INFRA , -52 , WPA2-PERSONAL
+ *
+ * Fields are located from the end of the line, as SSID may contain commas. Header, summary and OK lines are
+ * not network entries, and are reported as ERROR.
+ *
+ *
+ * @param scan_line - single line of scan response, without line termination.
+ * @param scan_result - channel scan result to add the network entry to.
+ * @return - outcome, SUCCESS if the line is a valid network entry or ERROR; defined by SUCCESS_ERROR.
+ *
+ */
+SUCCESS_ERROR gs_parse_channel_scan_line(char *scan_line, CHANNEL_SCAN_RESULT *scan_result){
+	int16_t comma_index[4] = {-1, -1, -1, -1};		/*Last four commas: after SSID, Channel, Type and RSSI*/
+	int16_t string_index = 0;
+	uint8_t comma_count = 0;
+	long channel = 0;
+	long rssi = 0;
+	char *field_end;
+
+	for(string_index = 0; scan_line[string_index] != '\0'; string_index++){
+		if(scan_line[string_index] == ','){
+			comma_index[0] = comma_index[1];
+			comma_index[1] = comma_index[2];
+			comma_index[2] = comma_index[3];
+			comma_index[3] = string_index;
+			comma_count++;
+		}
+	}
+
+	/*Valid entry has five fields separated by commas, after BSSID*/
+	if(comma_count < 5){
+		return ERROR;
+	}
+
+	channel = strtol(&scan_line[comma_index[0] + 1], &field_end, 10);
+	if((field_end == &scan_line[comma_index[0] + 1]) || (channel < WIRELESS_CHANNEL_1) || (channel > WIRELESS_CHANNEL_COUNT)){
+		return ERROR;
+	}
+
+	rssi = strtol(&scan_line[comma_index[2] + 1], &field_end, 10);
+	if((field_end == &scan_line[comma_index[2] + 1]) || (rssi >= 0)){
+		return ERROR;
+	}
+
+	if(scan_result->neighbour_count[channel] < UINT8_MAX){
+		scan_result->neighbour_count[channel]++;
+	}
+	if(rssi > WIRELESS_RSSI_FLOOR){
+		scan_result->neighbour_strength[channel] += (uint16_t) (rssi - WIRELESS_RSSI_FLOOR);
+	}
+	if(scan_result->networks_found < UINT8_MAX){
+		scan_result->networks_found++;
+	}
+
+	return SUCCESS;
+}
+
+
+/*!
+ * \brief Get congestion score of a channel.
+ *
+ *
+ * \details Score of a channel is the sum, over the channel and the channels overlapping with it, of neighbour
+ * strength and WIRELESS_NEIGHBOUR_PENALTY for each neighbour; weighted by the overlap i.e. neighbours on the same
+ * channel weigh (WIRELESS_CHANNEL_OVERLAP + 1), and neighbours WIRELESS_CHANNEL_OVERLAP channels apart weigh 1.
+ * Lower score is better.
+ *
+ *
+ * @param scan_result - channel scan result.
+ * @param channel - channel to score.
+ * @return - congestion score.
+ *
+ */
+uint32_t gs_get_channel_score(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL channel){
+	uint32_t channel_score = 0;
+	int8_t neighbour_channel = 0;
+	uint8_t channel_distance = 0;
+
+	for(neighbour_channel = WIRELESS_CHANNEL_1; neighbour_channel <= WIRELESS_CHANNEL_COUNT; neighbour_channel++){
+		channel_distance = abs(neighbour_channel - (int8_t) channel);
+		if(channel_distance <= WIRELESS_CHANNEL_OVERLAP){
+			channel_score += (uint32_t) (WIRELESS_CHANNEL_OVERLAP + 1 - channel_distance) *
+					(scan_result->neighbour_strength[neighbour_channel] + (uint16_t) WIRELESS_NEIGHBOUR_PENALTY * scan_result->neighbour_count[neighbour_channel]);
+		}
+	}
+
+	return channel_score;
+}
+
+
+/*!
+ * \brief Select the least congested channel.
+ *
+ *
+ * \details Selects the channel with the lowest score, refer gs_get_channel_score(). On equal score the default
+ * channel is preferred, followed by the non-overlapping channels 1, 6 and 11, and then the lowest channel.
+ *
+ *
+ * @param scan_result - channel scan result.
+ * @param default_channel - channel to keep when no channel has lower score.
+ * @return - selected wireless channel, valid values are defined by WIRELESS_CHANNEL.
+ *
+ */
+WIRELESS_CHANNEL gs_select_least_congested_channel(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL default_channel){
+	const WIRELESS_CHANNEL preferred_channels[] = {WIRELESS_CHANNEL_1, WIRELESS_CHANNEL_6, WIRELESS_CHANNEL_11};
+	WIRELESS_CHANNEL selected_channel = default_channel;
+	uint32_t selected_score = gs_get_channel_score(scan_result, default_channel);
+	uint32_t channel_score = 0;
+	uint8_t loop_counter = 0;
+	uint8_t channel = 0;
+
+	/*Strictly lower score is required to move away from default, and then from the preferred channels*/
+	for(loop_counter = 0; loop_counter < (sizeof(preferred_channels) / sizeof(preferred_channels[0])); loop_counter++){
+		channel_score = gs_get_channel_score(scan_result, preferred_channels[loop_counter]);
+		if(channel_score < selected_score){
+			selected_channel = preferred_channels[loop_counter];
+			selected_score = channel_score;
+		}
+	}
+	for(channel = WIRELESS_CHANNEL_1; channel <= WIRELESS_CHANNEL_COUNT; channel++){
+		channel_score = gs_get_channel_score(scan_result, (WIRELESS_CHANNEL) channel);
+		if(channel_score < selected_score){
+			selected_channel = (WIRELESS_CHANNEL) channel;
+			selected_score = channel_score;
+		}
+	}
+
+	return selected_channel;
+}
+
+
+/******************************************************************************************************************/
+/*!	@}*/
@@ -62,6 +62,24 @@
  *
  * \warning Ensure to define an unique SSID, to avoid conflict with neighbouring networks.
  *
+ * \note With SET_GAINSPAN_CHANNEL_SCAN_ON set to 1, the module scans for neighbouring networks before starting
+ * the Limited AP and starts it on the least congested channel; this adds approximately 3s to the initialization.
+ *
+ * \note Driver statistics (bytes, frames, parse errors, accepts, resets, per-command timeouts, and histograms of
+ * page-serve and command round-trip time) are collected at all times; read them with gs_get_statistics(), send
+ * them to serial terminal with gs_send_statistics_to_serial_terminal(), or over HTTP at /stats.
+ *
+ * \note Web server admission control: a request is served only if the requests, bytes sent and serve time of the
+ * current WEB_SERVER_BUDGET_WINDOW_IN_MILLISECONDS window are within the budget, and a web-page submission only if the
+ * client response buffer has room; otherwise it is answered with "503 Service Unavailable", which is fast. Call
+ * process_client_request() from a task with priority lower than motor and sensor tasks.
+ *
+ * \note With SET_WEB_SERVER_MODULE_BACKEND_ON set to 1, the Gainspan on-module web server (AT+WEBSERVER, with
+ * AT+XMLPARSE) handles HTTP framing and serves the web-page from module file system; requests to
+ * WEB_SERVER_MODULE_URI reach the MCU as parsed parameters, and routes reply with compact values only. To compare
+ * the backends, build each, serve the same requests, and compare bytes in/out per request and page-serve histogram
+ * reported by the driver statistics.
+ *
  * Usage guide (For "Limited AP" or hot-spot mode):
  *
  * 		=> Set SET_GAINSPAN_TERMINAL_OUTPUT_ON to 1 in "gainspan_gs1011m.h" to get the command response/progress on
@@ -102,6 +120,13 @@
  *
  *				add_element_choice('R', "Reverse");
  *
+ * 		=> Optionally, serve additional pages by adding routes, before starting the web server. The handler
+ * 			writes the complete HTTP response to the socket.
+ *
+ * 			call add_web_route(char *route_path, WEB_ROUTE_HANDLER route_handler)
+ *
+ * 			Example: add_web_route("/status", serve_status_page);
+ *
  * 		=> Start web server - with http port 80 and TCP protocol
  *
  * 			call start_web_server();
@@ -145,7 +170,9 @@
 #include <stdlib.h>
 
 #include <avr/io.h>
-#include <util/delay.h>
+
+/* other module includes */
+#include "include/custom_timer.h"					/* for time_in_microseconds(), to time statistics; and delay_milliseconds() */
 
 /* module includes */
 #include "include/wireless_interface.h"				/* module include */
@@ -166,6 +193,8 @@
 #define IP_SIZE 														15							/*!<Number of characters for IP, Subnet, gateway*/
 /*Polling interval, after issuing command, to check availability of response from Gainspan*/
 #define COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS				5							/*!<Polling interval, after issuing command, to check availability of response from Gainspan*/
+#define SOCKET_WRITE_DELAY_IN_MILLISECONDS								150							/*!<Maximum delay after writing data to socket, transmission of MAX_TX_BUFFER at 9600 baud*/
+#define SOCKET_WRITE_DELAY_MARGIN_IN_MILLISECONDS						20							/*!<Delay after transmission of data written to socket*/
 
 #define HTML_ELEMENT_LABEL_SIZE 										40							/*!<Label size (characters) for HTML elements on web-page*/
 #define WEB_PAGE_ELEMENTS 												10							/*!<Number of elements on web-page*/
@@ -239,6 +268,31 @@ typedef struct _HTML_WEB_PAGE {
 } HTML_WEB_PAGE;
 
 
+/*!\brief Data structure to hold a web server route.
+ *
+ * \details Path of the route i.e. first part of request URI, and the function serving it.
+ *
+ */
+typedef struct _WEB_ROUTE {
+	char *route_path;														/*!<Route path, example "/stats"*/
+	WEB_ROUTE_HANDLER route_handler;										/*!<Function serving the route*/
+} WEB_ROUTE;
+
+
+/*!\brief Data structure to hold web server resources used in the budget window.
+ *
+ * \details Resources used by the web server since start of the window; refer WEB_SERVER_BUDGET_WINDOW_IN_MILLISECONDS.
+ *
+ */
+typedef struct _WEB_SERVER_BUDGET {
+	unsigned long window_start_time;										/*!<Start of window in milliseconds*/
+	uint32_t window_start_bytes_in;											/*!<Driver statistics bytes in at start of window*/
+	uint32_t window_start_bytes_out;										/*!<Driver statistics bytes out at start of window*/
+	unsigned long serve_time;												/*!<Time serving requests in window, in microseconds*/
+	uint8_t requests;														/*!<Requests served in window*/
+} WEB_SERVER_BUDGET;
+
+
 /******************************************************************************************************************/
 /* CODING STANDARDS:
  * Program file: Section IV. Global   or   external   data   declarations -> externs, non­static globals, and then
@@ -369,6 +423,8 @@ typedef struct _GAINSPAN {
 	char *subnet;																		/*!<Gainspan network configuration: Subnet*/
 	char *gateway;																		/*!<Gainspan network configuration: Gateway*/
 	PROTOCOLS server_protocol;															/*!<Gainspan network configuration: Protocol - TCP/UDP*/
+	char *udp_client_address;															/*!<Gainspan network configuration: Destination IP address of UDP client being created*/
+	TCP_PORT udp_client_port;															/*!<Gainspan network configuration: Destination port of UDP client being created*/
 	TCP_PORT server_port;																/*!<Gainspan network configuration: Port - TCP/UDP*/
 	uint8_t server_number_of_connection;												/*!<Gainspan network configuration: Connection i.e. clients for TCP/UDP*/
 
@@ -388,6 +444,10 @@ typedef struct _GAINSPAN {
 
 	/*Data transmission flag/indicator*/
 	BOOLEAN_DATA data_transmission_completed; 											/*!<Data transmission status - BOOLEAN_TRUE or BOOLEAN_FALSE, default values BOOLEAN_TRUE indicates there is no data  */
+
+	/*Command round trip*/
+	AT_COMMAND pending_command;															/*!<Command sent and awaiting first character of response, AT_COMMAND_INVALID if none*/
+	unsigned long command_sent_time;													/*!<Time the pending command was sent, in microseconds*/
 } GAINSPAN;
 
 
@@ -408,6 +468,17 @@ char *client_response_buffer;															/*!<Circular buffer/Variable to hold
 uint8_t client_response_buffer_write_pointer = 0;										/*!<Write pointer*/
 uint8_t client_response_buffer_read_pointer = 0;										/*!<Read pointer*/
 WEB_SERVER_STATUS web_server_status = WEB_SERVER_NOT_ACTIVE;							/*!<Web server status*/
+WEB_ROUTE web_routes[WEB_ROUTES];														/*!<Web server routes, other than web-page*/
+uint8_t web_route_count = 0;															/*!<Web server route count added*/
+WEB_SERVER_BUDGET web_server_budget;													/*!<Web server resources used in the budget window*/
+uint16_t client_command_id = 0;															/*!<Identifier of the last command queued via /cmd*/
+
+
+GAINSPAN_STATISTICS gainspan_statistics;												/*!<Driver statistics*/
+
+/*Upper limits of histogram buckets in milliseconds; last bucket has no limit*/
+static const uint16_t page_serve_time_bucket_limits[STATISTICS_HISTOGRAM_BUCKETS - 1] = {250, 500, 1000, 2000, 4000, 8000, 16000};		/*!<Page-serve time histogram bucket limits*/
+static const uint16_t command_round_trip_time_bucket_limits[STATISTICS_HISTOGRAM_BUCKETS - 1] = {5, 10, 25, 50, 100, 250, 500};		/*!<Command round-trip time histogram bucket limits*/
 
 
 /******************************************************************************************************************/
@@ -449,8 +520,50 @@ void gs_send_command_response_to_serial_terminal(AT_COMMAND at_command, COMMAND_
 
 void gs_send_activation_status_to_serial_terminal(GAINSPAN_ACTIVE gs_active);
 
+COMMAND_OUTCOME gs_get_channel_scan_response(CHANNEL_SCAN_RESULT *scan_result, uint16_t polling_period_in_milliseconds);
+
+void gs_send_channel_scan_result_to_serial_terminal(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL selected_channel);
+
 void initialize_web_server(uint16_t port, uint8_t protocol);
 
+void send_web_page(TCP_SOCKET socket);
+
+WEB_ROUTE_HANDLER process_request_path(char *request_path, char **query);
+
+SUCCESS_ERROR queue_client_response(char client_response);
+
+SUCCESS_ERROR web_server_admit_request(void);
+
+void web_server_charge_request(unsigned long serve_time);
+
+void serve_service_unavailable(TCP_SOCKET socket, char *query);
+
+void serve_not_found(TCP_SOCKET socket, char *query);
+
+void serve_command(TCP_SOCKET socket, char *query);
+
+SUCCESS_ERROR gs_start_module_web_server(void);
+
+void process_module_client_request(void);
+
+uint16_t gs_parse_module_web_server_frame(char *frame_string, uint16_t frame_length, uint8_t *cid, char **payload);
+
+void gs_write_module_web_server_frame(uint8_t cid, char *data_string);
+
+WEB_ROUTE_HANDLER find_web_route(char *request_path, char **query);
+
+void serve_statistics_page(TCP_SOCKET socket, char *query);
+
+void gs_write_to_usart(char *string_buffer);
+
+void gs_record_response_received(void);
+
+void gs_record_response_timeout(void);
+
+void gs_record_time_in_histogram(uint16_t *histogram, const uint16_t *bucket_limits, unsigned long elapsed_microseconds);
+
+void gs_format_histogram(char *string_buffer, char *histogram_title, uint16_t *histogram, const uint16_t *bucket_limits);
+
 uint8_t hex_to_int(char character);
 
 char int_to_hex(uint8_t character);
@@ -703,6 +816,12 @@ GAINSPAN_ACTIVE gs_activate_wireless_connection(void){
 	}
 
 	if (gainspan.wireless_mode == WIRELESS_MODE_LIMITEDAP){
+		#if SET_GAINSPAN_CHANNEL_SCAN_ON == 1
+			/*Scan neighbouring networks, and select the least congested channel before starting the network*/
+			/*do not include this towards outcome success or error, configured channel is kept on failure*/
+			gs_scan_for_least_congested_channel();
+		#endif
+
 		/*Set network stack parameters*/
 		strcpy(gs_command_response, "\0");
 		gs_send_command(AT_SET_STATIC_NETWORK_PARAMTERS_IPV4);
@@ -782,6 +901,50 @@ GAINSPAN_ACTIVE gs_activate_wireless_connection(void){
 }
 
 
+/*!
+ * \brief Scan neighbouring networks and select the least congested channel.
+ *
+ *
+ * \details Scans all channels for neighbouring networks, scores each channel by neighbour count and RSSI
+ * of the neighbours on the channel and on overlapping channels, and sets the channel with lowest score
+ * as wireless channel (gainspan.wireless_channel) for starting the network. The decision is sent to the
+ * serial terminal.
+ *
+ * \note The configured channel is kept if the scan fails, or if no channel is better than it.
+ *
+ * \note Takes up to CHANNEL_SCAN_POLLING_PERIOD_IN_MILLISECONDS to complete.
+ *
+ *
+ * @return - selected wireless channel, valid values are defined by WIRELESS_CHANNEL.
+ *
+ */
+WIRELESS_CHANNEL gs_scan_for_least_congested_channel(void){
+	CHANNEL_SCAN_RESULT scan_result;
+	COMMAND_OUTCOME command_result = COMMAND_OUTCOME_NO_RESPONSE;
+	WIRELESS_CHANNEL selected_channel = gainspan.wireless_channel;
+
+	gs_clear_channel_scan_result(&scan_result);
+
+	gs_send_command(AT_SCAN_NETWORK_FOR_SSID);
+	command_result = gs_get_channel_scan_response(&scan_result, CHANNEL_SCAN_POLLING_PERIOD_IN_MILLISECONDS);
+	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+		gs_send_command_response_to_serial_terminal(AT_SCAN_NETWORK_FOR_SSID, command_result);
+	#endif
+
+	if(command_result == COMMAND_OUTCOME_SUCCESS){
+		selected_channel = gs_select_least_congested_channel(&scan_result, gainspan.wireless_channel);
+	}
+
+	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+		gs_send_channel_scan_result_to_serial_terminal(&scan_result, selected_channel);
+	#endif
+
+	gainspan.wireless_channel = selected_channel;
+
+	return selected_channel;
+}
+
+
 /*!
  * \brief Get socket status.
  *
@@ -977,23 +1140,23 @@ SUCCESS_ERROR gs_reset_socket(TCP_SOCKET socket){
 
 		/*Escape sequence indicating data mode - Escape*/
 		sprintf(command_buffer,"\x1b");
-		usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+		gs_write_to_usart(command_buffer);
 
 		/*TCP Data start - S 0x53*/
 		sprintf(command_buffer,"\x53");
-		usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+		gs_write_to_usart(command_buffer);
 
 		/*Put client CID based on socket*/
 		sprintf(command_buffer,"%x", (uint8_t) gainspan.socket_table[socket].cid);
-		usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+		gs_write_to_usart(command_buffer);
 
 		/*TCP Data end - E - 0x45*/
 		sprintf(command_buffer,"\x1b");
-		usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+		gs_write_to_usart(command_buffer);
 
 		//sprintf(command_buffer,"\x45");
 		sprintf(command_buffer,"\x43");
-		usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+		gs_write_to_usart(command_buffer);
 
 		/*Reset socket.*/
 		strcpy(gainspan.socket_table[socket].ip_address, "0.0.0.0");
@@ -1005,6 +1168,7 @@ SUCCESS_ERROR gs_reset_socket(TCP_SOCKET socket){
 		//gainspan.active_socket = NO_ACTIVE_SOCKET; 						// No need to modify the active socket
 		gainspan.socket_with_data = NO_SOCKET_WTIH_DATA;
 		gainspan.device_operation_mode = GAINSPAN_DEVICE_MODE_COMMAND;
+		gainspan_statistics.resets++;
 		process_result = SUCCESS;
 
 	}
@@ -1134,6 +1298,7 @@ SUCCESS_ERROR gs_read_data_from_socket(char *data_string){
 				}
 				gainspan.data_transmission_completed = BOOLEAN_FALSE;
 				cid_extracted = BOOLEAN_TRUE;
+				gainspan_statistics.frames_parsed++;
 			}
 			/*Receive data*/
 			if ((cid_extracted == BOOLEAN_TRUE) && (gainspan.device_operation_mode == GAINSPAN_DEVICE_MODE_DATA_RX)){
@@ -1150,6 +1315,10 @@ SUCCESS_ERROR gs_read_data_from_socket(char *data_string){
 				process_result = SUCCESS;
 			}
 		}
+		/*Data received, but neither a response nor start of a frame*/
+		if ((process_result == ERROR) && (gainspan.socket_with_data == NO_SOCKET_WTIH_DATA)){
+			gainspan_statistics.parse_errors++;
+		}
 	}
 
 	return process_result;
@@ -1199,12 +1368,104 @@ SUCCESS_ERROR gs_get_socket_connection_status(TCP_SOCKET socket){
 }
 
 
+/*!
+ * \brief Open UDP client connection on a socket.
+ *
+ *
+ * \details Creates UDP client connection to destination address and port on a closed socket; datagrams are sent
+ * with gs_write_binary_data_to_socket(). Active socket and client CID are not changed, hence the web server
+ * connection is not disturbed.
+ *
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER; socket must be closed.
+ * @param destination_address - IPv4 address of destination, example "192.168.3.2".
+ * @param destination_port - port of destination.
+ * @return - outcome, SUCCESS or ERROR; defined by SUCCESS_ERROR.
+ *
+ */
+SUCCESS_ERROR gs_open_udp_client(TCP_SOCKET socket, char *destination_address, TCP_PORT destination_port){
+	char gs_command_response[MAX_TX_BUFFER] = "\0";
+	char *connect_response = NULL;
+	TCP_SOCKET active_socket = gainspan.active_socket;
+	uint8_t active_client_cid = gainspan.active_client_cid;
+	SUCCESS_ERROR process_result = ERROR;
+
+	if (gs_get_socket_status(socket) != SOCKET_STATUS_CLOSED){
+		return ERROR;
+	}
+
+	gainspan.udp_client_address = destination_address;
+	gainspan.udp_client_port = destination_port;
+	strcpy(gs_command_response, "\0");
+	gs_send_command(AT_START_UDP_CLIENT);
+	gs_get_command_response(gs_command_response, UDP_CLIENT_POLLING_PERIOD_IN_MILLISECONDS);
+	gainspan.udp_client_address = NULL;
+
+	/*Response: CONNECT <CID>, followed by OK*/
+	connect_response = strstr(gs_command_response, "CONNECT ");
+	if ((connect_response != NULL) && (strstr(gs_command_response, "ERROR") == NULL)){
+		gs_configure_socket(socket, PROTOCOL_UDP_CLIENT, destination_port);
+		strncpy(gainspan.socket_table[socket].ip_address, destination_address, IP_SIZE - 1);
+		gainspan.socket_table[socket].ip_address[IP_SIZE - 1] = '\0';
+		gainspan.socket_table[socket].cid = hex_to_int(connect_response[8]);
+		gainspan.socket_table[socket].status = SOCKET_STATUS_ESTABLISHED;
+		process_result = SUCCESS;
+	}else{
+		gainspan_statistics.parse_errors++;
+	}
+	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+		gs_send_command_response_to_serial_terminal(AT_START_UDP_CLIENT, (process_result == SUCCESS) ? COMMAND_OUTCOME_SUCCESS : COMMAND_OUTCOME_ERROR);
+	#endif
+
+	/*Restore active socket, changed by gs_configure_socket()*/
+	gainspan.active_socket = active_socket;
+	gainspan.active_client_cid = active_client_cid;
+	return process_result;
+}
+
+
+/*!
+ * \brief Write binary data to socket.
+ *
+ *
+ * \details Writes data with bulk data transfer i.e. Escape 'Z', CID, 4 digit data length, and data; data may have
+ * any byte value including zero. Sent as a single datagram on UDP client socket.
+ * \note Unlike gs_write_data_to_socket(), no delay is introduced; USART transmission is buffered.
+ *
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param data - data to be written.
+ * @param data_length - number of bytes, limited by WEB_SERVER_MODULE_FRAME_DATA_SIZE.
+ *
+ */
+void gs_write_binary_data_to_socket(TCP_SOCKET socket, uint8_t *data, uint16_t data_length){
+	char command_buffer[12];
+	uint16_t data_index = 0;
+
+	if ((gs_get_socket_status(socket) != SOCKET_STATUS_ESTABLISHED) || (data_length > WEB_SERVER_MODULE_FRAME_DATA_SIZE)){
+		return;
+	}
+
+	/*Escape sequence, Z - bulk data, CID and data length*/
+	sprintf(command_buffer, "\x1bZ%x%04u", (uint8_t) gainspan.socket_table[socket].cid, data_length);
+	gs_write_to_usart(command_buffer);
+
+	/*Transmit data byte by byte, string output stops at zero*/
+	for (data_index = 0; data_index < data_length; data_index++){
+		usartWrite(gainspan.usart_id, data[data_index]);
+	}
+	gainspan_statistics.bytes_out += data_length;
+}
+
+
 /*!
  * \brief Write data to socket.
  *
  *
  * \details Write data to socket.
- * Introduces 150 ms delay for complete transfer of data.
+ * Introduces a delay for complete transfer of data: transmission time of the characters written, 10 bits each at
+ * Gainspan baud rate, plus SOCKET_WRITE_DELAY_MARGIN_IN_MILLISECONDS; at most SOCKET_WRITE_DELAY_IN_MILLISECONDS.
+ * A short response takes around 60 ms instead of 150 ms.
  *
  *
  * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
@@ -1213,6 +1474,8 @@ SUCCESS_ERROR gs_get_socket_connection_status(TCP_SOCKET socket){
  */
 void gs_write_data_to_socket(TCP_SOCKET socket, char *data_string){
 	char command_buffer[MAX_TX_BUFFER];
+	uint32_t bytes_out_at_start = gainspan_statistics.bytes_out;
+	uint32_t write_delay = 0;
 
 	memset(command_buffer, ' ', MAX_TX_BUFFER);
 
@@ -1223,41 +1486,46 @@ void gs_write_data_to_socket(TCP_SOCKET socket, char *data_string){
 
 			/*Escape sequence indicating data mode - Escape*/
 			sprintf(command_buffer,"\x1b");
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 
 			/*TCP Data start - S 0x53*/
 			sprintf(command_buffer,"\x53");
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 
 			/*Put client CID based on socket*/
 			sprintf(command_buffer,"%x", (uint8_t) gainspan.socket_table[socket].cid);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 
 			/*Transmit data*/
 			if(strlen(data_string) == 1){
 	            if(data_string[0] != '\r' && data_string[0] != '\n'){
 					sprintf(command_buffer,"%s\n\r", data_string);
-					usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+					gs_write_to_usart(command_buffer);
 	            } else if (data_string[0] == '\n') {
 					sprintf(command_buffer,"\n\r");
-					usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+					gs_write_to_usart(command_buffer);
 	            }
 			}else{
 				sprintf(command_buffer,"%s", data_string);
-				usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+				gs_write_to_usart(command_buffer);
 			}
 
 			/*TCP Data end - E - 0x45*/
 			sprintf(command_buffer,"\x1b");
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 
 			sprintf(command_buffer,"\x45");
 			//sprintf(command_buffer,"\x43");
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 		}
 	}
 	/*Delay for transmission to complete*/
-	 _delay_ms(150);
+	write_delay = ((gainspan_statistics.bytes_out - bytes_out_at_start) * 10000UL) / (uint32_t) gainspan.baud_rate;
+	write_delay += SOCKET_WRITE_DELAY_MARGIN_IN_MILLISECONDS;
+	if (write_delay > SOCKET_WRITE_DELAY_IN_MILLISECONDS){
+		write_delay = SOCKET_WRITE_DELAY_IN_MILLISECONDS;
+	}
+	delay_milliseconds(write_delay);
 }
 
 
@@ -1273,10 +1541,123 @@ void gs_flush(void){
 	 unsigned char character_from_response = ' ';
 	 while (usart_AvailableCharRx(gainspan.usart_id)){
 		usart_xgetChar(gainspan.usart_id, &character_from_response);
+		gainspan_statistics.bytes_dropped++;
 	 }
 }
 
 
+/*!
+ * \brief Get driver statistics.
+ *
+ *
+ * \details Copies driver statistics.
+ *
+ *
+ * @param statistics - pointer, statistics will be copied to.
+ *
+ */
+void gs_get_statistics(GAINSPAN_STATISTICS *statistics){
+	memcpy(statistics, &gainspan_statistics, sizeof(GAINSPAN_STATISTICS));
+}
+
+
+/*!
+ * \brief Clear driver statistics.
+ *
+ *
+ * \details Sets all the counters and histograms to zero.
+ *
+ *
+ */
+void gs_clear_statistics(void){
+	memset(&gainspan_statistics, 0, sizeof(GAINSPAN_STATISTICS));
+}
+
+
+/*!
+ * \brief Format a line of driver statistics.
+ *
+ *
+ * \details Formats the requested line of driver statistics report, without line termination. Lines are:
+ * 	- 0: bytes in, out, and dropped; and bytes in and out per request
+ * 	- 1: frames parsed, parse errors, accepts, resets, pages served, and requests rejected
+ * 	- 2: page-serve time histogram
+ * 	- 3: command round-trip time histogram
+ * 	- 4: command timeouts, as AT command identifier:count for commands having timeouts
+ *
+ *
+ * @param string_buffer - string buffer to return the line, minimum MAX_TX_BUFFER characters.
+ * @param line_number - line to format.
+ * @return - 1 if line is formatted, 0 if line_number is beyond the last line.
+ *
+ */
+uint8_t gs_format_statistics(char *string_buffer, uint8_t line_number){
+	uint8_t at_command = 0;
+
+	strcpy(string_buffer, "\0");
+
+	switch(line_number){
+		case 0:
+			sprintf(string_buffer, "bytes in:%lu out:%lu dropped:%lu", (unsigned long) gainspan_statistics.bytes_in,
+					(unsigned long) gainspan_statistics.bytes_out, (unsigned long) gainspan_statistics.bytes_dropped);
+			/*Average per request, to compare web server backends*/
+			if (gainspan_statistics.pages_served > 0){
+				sprintf(string_buffer + strlen(string_buffer), " per request in:%lu out:%lu",
+						(unsigned long) (gainspan_statistics.bytes_in / gainspan_statistics.pages_served),
+						(unsigned long) (gainspan_statistics.bytes_out / gainspan_statistics.pages_served));
+			}
+			break;
+		case 1:
+			sprintf(string_buffer, "frames:%u parse errors:%u accepts:%u resets:%u pages:%u rejected:%u", gainspan_statistics.frames_parsed,
+					gainspan_statistics.parse_errors, gainspan_statistics.accepts, gainspan_statistics.resets, gainspan_statistics.pages_served,
+					gainspan_statistics.requests_rejected);
+			break;
+		case 2:
+			gs_format_histogram(string_buffer, "page serve ms", gainspan_statistics.page_serve_time_histogram, page_serve_time_bucket_limits);
+			break;
+		case 3:
+			gs_format_histogram(string_buffer, "command rtt ms", gainspan_statistics.command_round_trip_time_histogram, command_round_trip_time_bucket_limits);
+			break;
+		case 4:
+			strcpy(string_buffer, "command timeouts");
+			for(at_command = 0; at_command < AT_COMMAND_COUNT; at_command++){
+				if (gainspan_statistics.command_timeouts[at_command] > 0){
+					/*Room for " 45:65535" and " ..."*/
+					if (strlen(string_buffer) > (MAX_TX_BUFFER - 15)){
+						strcat(string_buffer, " ...");
+						break;
+					}
+					sprintf(string_buffer + strlen(string_buffer), " %u:%u", at_command, gainspan_statistics.command_timeouts[at_command]);
+				}
+			}
+			break;
+		default:
+			return 0;
+	}
+	return 1;
+}
+
+
+/*!
+ * \brief Send driver statistics to serial terminal.
+ *
+ *
+ * \details Sends all the lines of driver statistics report, refer gs_format_statistics().
+ *
+ *
+ */
+void gs_send_statistics_to_serial_terminal(void){
+	char string_buffer[MAX_TX_BUFFER] = "\0";
+	uint8_t line_number = 0;
+
+	usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) "\n\rGainspan statistics:\n\r");
+	for(line_number = 0; gs_format_statistics(string_buffer, line_number) == 1; line_number++){
+		usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) string_buffer);
+		usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) "\n\r");
+	}
+}
+
+
 /*!\brief Configure web-page.
  *
  * \details Configure web-page with details of web-page title, HTML element type.
@@ -1305,7 +1686,8 @@ void configure_web_page(char *page_title, char *menu_title, HTML_ELEMENT_TYPE el
 	client_web_page.element_count = 0;
 	/*Client response buffer*/
 	client_response_buffer = (char *)pvPortMalloc( sizeof(char) * RING_BUFFER_SIZE);
-	strcpy(client_response_buffer, "\0");
+	/*Blank positions are free, refer get_next_client_response()*/
+	memset(client_response_buffer, ' ', RING_BUFFER_SIZE);
 
 	/*Set element type*/
 	if (element_type != HTML_DROPDOWN_LIST && element_type != HTML_RADIO_BUTTON){
@@ -1331,9 +1713,12 @@ void configure_web_page(char *page_title, char *menu_title, HTML_ELEMENT_TYPE el
 		strncpy(client_web_page.menu_title, menu_title, WEB_TITLE_SIZE);
 	}
 	client_web_page.element_count = 0;
-	strcpy(client_response_buffer, "");
 	client_response_buffer_write_pointer = 0;
 	client_response_buffer_read_pointer = 0;
+	/*Routes*/
+	web_route_count = 0;
+	add_web_route("/stats", serve_statistics_page);
+	add_web_route("/cmd", serve_command);
 	#if SET_WEB_SERVER_TERMINAL_OUTPUT_ON == 1
 		/*Send message to serial terminal*/
 		usart_xfprint(SERIAL_TERNMINAL, (uint8_t *) "\n\rWeb Page: configured....\n\r");
@@ -1388,13 +1773,122 @@ void add_element_choice(char choice_identifier, char *element_label){
 			#if SET_WEB_SERVER_TERMINAL_OUTPUT_ON == 1
 				/*Send message to serial terminal*/
 				usart_xfprint(SERIAL_TERNMINAL, (uint8_t *) "\n\rWeb Page: can't add element, max 10 allowed....\n\r");
-				_delay_ms(5000);
+				delay_milliseconds(5000);
 			#endif
 		}
 	}
 }
 
 
+/*!\brief Add a web server route.
+ *
+ * \details Adds a route served by route_handler instead of the web-page. A request is served by the route
+ * if its path is route_path, optionally followed by a query i.e. '?' and parameters.
+ * \note Route "/stats" is added by configure_web_page(), and serves driver statistics.
+ *
+ * @param route_path - route path, example "/status"; the string is not copied, hence must remain valid
+ * @param route_handler - function serving the route, writes the complete HTTP response
+ *
+ */
+void add_web_route(char *route_path, WEB_ROUTE_HANDLER route_handler){
+	if (web_route_count < WEB_ROUTES){
+		web_routes[web_route_count].route_path = route_path;
+		web_routes[web_route_count].route_handler = route_handler;
+		web_route_count++;
+		#if SET_WEB_SERVER_TERMINAL_OUTPUT_ON == 1
+			/*Send message to serial terminal*/
+			usart_xfprint(SERIAL_TERNMINAL, (uint8_t *) "\n\rWeb Page: route added....\n\r");
+		#endif
+	}else{
+		#if SET_WEB_SERVER_TERMINAL_OUTPUT_ON == 1
+			/*Send message to serial terminal*/
+			usart_xfprint(SERIAL_TERNMINAL, (uint8_t *) "\n\rWeb Page: can't add route, limit reached....\n\r");
+		#endif
+	}
+}
+
+
+/*!\brief Send HTTP response header.
+ *
+ * \details Sends status line and content type, followed by blank line, in a single write to the socket.
+ * \note Nothing is sent with on-module web server backend, the module adds the header.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param status - status code and reason, example "200 OK"
+ * @param content_type - content type, example "text/plain"; NULL if response has no content
+ *
+ */
+void send_http_response_header(TCP_SOCKET socket, char *status, char *content_type){
+	char header_string[MAX_TX_BUFFER] = "\0";
+
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		/*On-module web server adds the header*/
+		return;
+	#endif
+
+	if (content_type != NULL){
+		sprintf(header_string, "HTTP/1.1 %s\nContent-Type: %s\n\n", status, content_type);
+	}else{
+		sprintf(header_string, "HTTP/1.1 %s\n\n", status);
+	}
+	gs_write_data_to_socket(socket, header_string);
+}
+
+
+/*!\brief Send HTTP response data.
+ *
+ * \details Sends response data of a route, to the socket; or to the client CID of the request as a compact
+ * response frame with on-module web server backend.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param data_string - data to be written. Limited by MAX_TX_BUFFER
+ *
+ */
+void send_http_response_data(TCP_SOCKET socket, char *data_string){
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		gs_write_module_web_server_frame(gainspan.active_client_cid, data_string);
+	#else
+		gs_write_data_to_socket(socket, data_string);
+	#endif
+}
+
+
+/*!\brief Send HTTP response.
+ *
+ * \details Sends header and data of a short response in a single write to the socket, one transmission delay instead
+ * of two; falls back to separate writes if they don't fit MAX_TX_BUFFER. Only data is sent with on-module web server
+ * backend.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param status - status code and reason, example "200 OK"
+ * @param content_type - content type, example "text/plain"; NULL to omit, which saves bytes for frequent responses
+ * @param data_string - data to be written
+ *
+ */
+void send_http_response(TCP_SOCKET socket, char *status, char *content_type, char *data_string){
+	char response_string[MAX_TX_BUFFER] = "\0";
+	int response_length = 0;
+
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		/*On-module web server adds the header*/
+		send_http_response_data(socket, data_string);
+		return;
+	#endif
+
+	if (content_type != NULL){
+		response_length = snprintf(response_string, MAX_TX_BUFFER, "HTTP/1.1 %s\nContent-Type: %s\n\n%s", status, content_type, data_string);
+	}else{
+		response_length = snprintf(response_string, MAX_TX_BUFFER, "HTTP/1.1 %s\n\n%s", status, data_string);
+	}
+	if ((response_length > 0) && (response_length < MAX_TX_BUFFER)){
+		gs_write_data_to_socket(socket, response_string);
+	}else{
+		send_http_response_header(socket, status, content_type);
+		send_http_response_data(socket, data_string);
+	}
+}
+
+
 /*!\brief Start the web-server.
  *
  * \details Initializes and start the web-server, web-sever starts to listen to clients
@@ -1405,6 +1899,8 @@ void add_element_choice(char choice_identifier, char *element_label){
  *	server port = 80;
  *	server protocol = PROTOCOL_TCP;
  *
+ * \note With SET_WEB_SERVER_MODULE_BACKEND_ON set to 1, starts the on-module web server instead.
+ *
  * \warning Ensure web-page is configured and required elements are added, before starting/activating sever.
  *
  *
@@ -1416,6 +1912,17 @@ void start_web_server(void){
 	if (client_web_page.element_count > 0){
 		/*Initialize the server*/
 		initialize_web_server(port, protocol);
+		#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+			/*On-module web server listens, no socket is required*/
+			if (gs_start_module_web_server() == SUCCESS){
+				#if SET_WEB_SERVER_TERMINAL_OUTPUT_ON == 1
+					/*Send message to serial terminal*/
+					usart_xfprint(SERIAL_TERNMINAL, (uint8_t *) "\n\rWeb Server: Started on module....\n\r");
+				#endif
+				web_server_status = WEB_SERVER_ACTIVE;
+			}
+			return;
+		#endif
 		/*Search for available socket, activate and start to listen incoming connection*/
 		for (TCP_SOCKET socket  = 0; socket < MAX_SOCKET_NUMBER; socket++){
 			if (gs_get_socket_status(socket) == SOCKET_STATUS_CLOSED){
@@ -1446,8 +1953,9 @@ void start_web_server(void){
 
 /*!\brief Process client request.
  *
- * \details accepts incoming connection on socket, sends the web-page and
+ * \details accepts incoming connection on socket, sends the web-page (or serves the requested route) and
  * reads the client response
+ * \note With SET_WEB_SERVER_MODULE_BACKEND_ON set to 1, processes the requests forwarded by on-module web server.
  * \warning Ensure web-page is configured and web server is started before calling this routine/function.
  *
  *
@@ -1455,95 +1963,56 @@ void start_web_server(void){
 void process_client_request(void){
 
 	char data_string[96] = "\0";
-	char html_string[96] = "\0";
 	char find_GET_in_response[94] = "\0";
-	char client_response = ' ';
-	uint8_t loop_counter = 0;
+	char *request = NULL;
+	char *query = "";
+	WEB_ROUTE_HANDLER route_handler = NULL;
+	unsigned long page_serve_start_time = 0;
+	unsigned long page_serve_time = 0;
+
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		process_module_client_request();
+		return;
+	#endif
 
 	if (web_server_status == WEB_SERVER_ACTIVE){
 		if (gs_get_socket_status(wifi_client.client_socket) == SOCKET_STATUS_LISTEN){
 			gs_read_data_from_socket(data_string); //accept connection, get CID
 			/*Extract client request and store in ring buffer*/
 			if(strlen(data_string) > 0){
-				strcpy(find_GET_in_response, strstr(data_string, "GET"));
-				if (*(find_GET_in_response + 5) == '?'){
-					client_response = *(find_GET_in_response + 8);
-
-					/*Add to circular buffer for processing*/
-					client_response_buffer[client_response_buffer_write_pointer] = client_response;
-					client_response_buffer_write_pointer++;
-					if (client_response_buffer_write_pointer >= RING_BUFFER_SIZE){
-						client_response_buffer_write_pointer = 0;
+				request = strstr(data_string, "GET");
+				if (request != NULL){
+					strcpy(find_GET_in_response, request);
+					if (web_server_admit_request() == SUCCESS){
+						/*Request path follows "GET "*/
+						route_handler = process_request_path(find_GET_in_response + 4, &query);
+					}else{
+						route_handler = serve_service_unavailable;
 					}
 				}
 			}
 			if(gs_get_socket_status(wifi_client.client_socket) == SOCKET_STATUS_ESTABLISHED){
-				//HTML header
-				gs_write_data_to_socket(wifi_client.client_socket, "HTTP/1.1 200 OK\n");
-				gs_write_data_to_socket(wifi_client.client_socket, "Content-Type: text/html\n\n");
-				gs_write_data_to_socket(wifi_client.client_socket, "<!DOCTYPE HTML>\n\n");
-				//Send web page HTML script/code
-				gs_write_data_to_socket(wifi_client.client_socket, "<html> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "<head> \n");
-				/*Page title*/
-				strcpy(html_string, "<title>");
-				strcat(html_string, client_web_page.page_title);
-				strcat(html_string, "</title> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, html_string);
-				gs_write_data_to_socket(wifi_client.client_socket, "</head> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "<body> \n");
-				/*Page title*/
-				strcpy(html_string, "<center><h1>");
-				strcat(html_string, client_web_page.page_title);
-				strcat(html_string, "</h1> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, html_string);
-				strcpy(html_string, "<center><h3>");
-				strcat(html_string, client_web_page.menu_title);
-				strcat(html_string, "</h3> \n\n");
-				gs_write_data_to_socket(wifi_client.client_socket, html_string);
-				gs_write_data_to_socket(wifi_client.client_socket, "<p> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "<form method=\"get\" action=\"\"> \n");
-				/*Check for element type*/
-				if (client_web_page.element_type == HTML_DROPDOWN_LIST ){
-					gs_write_data_to_socket(wifi_client.client_socket, "<select name=\"l\"> \n");
-					/*Add the elements*/
-					for (loop_counter = 0; loop_counter < client_web_page.element_count; loop_counter++){
-						strcpy(html_string, "<option value=\"");
-						strncat(html_string, &client_web_page.web_page_elements[loop_counter].element_identifier, 1);
-						strcat(html_string, "\">");
-						strcat(html_string, client_web_page.web_page_elements[loop_counter].element_label);
-						strcat(html_string, "</option> \n");
-						gs_write_data_to_socket(wifi_client.client_socket, html_string);
-					}
-					gs_write_data_to_socket(wifi_client.client_socket, "</select> \n");
-				}else if (client_web_page.element_type == HTML_RADIO_BUTTON){
-					for (loop_counter = 0; loop_counter < client_web_page.element_count; loop_counter++){
-						strcpy(html_string, "<input type=\"radio\" name=\"choice\" value=\"");
-						strncat(html_string, &client_web_page.web_page_elements[loop_counter].element_identifier, 1);
-						strcat(html_string, "\">");
-						strcat(html_string, client_web_page.web_page_elements[loop_counter].element_label);
-						strcat(html_string, " \n");
-						gs_write_data_to_socket(wifi_client.client_socket, html_string);
-					}
+				page_serve_start_time = time_in_microseconds();
+
+				if (route_handler != NULL){
+					route_handler(wifi_client.client_socket, query);
 				}else{
-					gs_write_data_to_socket(wifi_client.client_socket, "<center><h3> No valid elements added, please check! </h3> \n\n");
+					send_web_page(wifi_client.client_socket);
 				}
-				gs_write_data_to_socket(wifi_client.client_socket, "<input type=\"submit\" value=\"Set\"> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "</form> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "</p> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "</center> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "</body> \n");
-				gs_write_data_to_socket(wifi_client.client_socket, "</html>");
-				gs_write_data_to_socket(wifi_client.client_socket, "");
-				gs_write_data_to_socket(wifi_client.client_socket, " ");
-//				gs_write_data_to_socket(wifi_client.client_socket, "HTTP/1.1 205 Reset Content\n");
 
 				gs_reset_socket(wifi_client.client_socket);
 
 				gs_flush();
 
+				page_serve_time = time_in_microseconds() - page_serve_start_time;
+				gainspan_statistics.pages_served++;
+				gs_record_time_in_histogram(gainspan_statistics.page_serve_time_histogram, page_serve_time_bucket_limits, page_serve_time);
+				if (route_handler != serve_service_unavailable){
+					web_server_charge_request(page_serve_time);
+				}
+
 				/*Wait for web browser to get refresh*/
-				_delay_ms(100);
+				delay_milliseconds(100);
 			}
 		}
 	}
@@ -1601,7 +2070,7 @@ char get_next_client_response(void){
  * 	- Wireless authentication mode = AUTHENTICATION_MODE_NONE
  * 	- Wireless security configuration = WIRELESS_SECURITY_CONFIGURATION_WPA_PSK_SECURITY
  * 	- Transmission rate = TRANSMISSION_RATE_AUTO
- * 	- Wireless channel = WIRELESS_CHANNEL_11
+ * 	- Wireless channel = WIRELESS_CHANNEL_11; replaced by least congested channel when SET_GAINSPAN_CHANNEL_SCAN_ON is 1
  * 	- Device local IP address = "192.168.1.1"
  * 	- Device subnet = "255.255.255.0"
  * 	- Device gateway = "192.168.1.1"
@@ -1648,6 +2117,8 @@ void gs_initialize_gainspan(void){
 	gainspan.gateway = (char *)pvPortMalloc( sizeof(char) * IP_SIZE);
 	strcpy(gainspan.gateway, "192.168.3.1");
 	gainspan.server_protocol = PROTOCOL_TCP;
+	gainspan.udp_client_address = NULL;
+	gainspan.udp_client_port = INVALID_PORT;
 	gainspan.server_port = 80;
 	gainspan.server_number_of_connection = 1;
 	gainspan.web_server_administrator_id = "admin";
@@ -1667,6 +2138,7 @@ void gs_initialize_gainspan(void){
 	gainspan.active_client_cid = INVALID_CID;
 	gainspan.device_operation_mode = GAINSPAN_DEVICE_MODE_COMMAND;
 	gainspan.data_transmission_completed = BOOLEAN_TRUE;
+	gainspan.pending_command = AT_COMMAND_INVALID;
 }
 
 
@@ -1682,27 +2154,30 @@ void gs_initialize_gainspan(void){
  */
 void gs_send_command(AT_COMMAND at_command){
 	char command_buffer[50];
+	uint32_t bytes_out_before_command = 0;
 	memset(command_buffer, ' ', 50);
 
 	/*Flush to transmission buffer*/
 	gs_flush();
 
+	bytes_out_before_command = gainspan_statistics.bytes_out;
+
 	switch(at_command){
 		case AT_OK:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISABLE_ECHO:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_VERBOSE_ENABLE:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_USART:
 			sprintf(command_buffer,"%s%lu,8,n,1\n\r", gs_at_commands[at_command], (uint32_t) gainspan.baud_rate);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_GET_DEVICE_OEM_ID:
 			break;
@@ -1713,18 +2188,21 @@ void gs_send_command(AT_COMMAND at_command){
 		case AT_GET_DEVICE_MAC_ADDRESS:
 			break;
 		case AT_SCAN_NETWORK_FOR_SSID:
+			/*No SSID i.e. without '=', scan all channels for all networks*/
+			sprintf(command_buffer,"%.*s\n\r", (int) (strlen(gs_at_commands[at_command]) - 1), gs_at_commands[at_command]);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_WIRELESS_MODE:
 			sprintf(command_buffer,"%s%u\n\r", gs_at_commands[at_command], (uint8_t) gainspan.wireless_mode);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_ASSOCIATE_START_NETWORK:
 			sprintf(command_buffer,"%s%s,,%u\n\r", gs_at_commands[at_command], gainspan.ssid, (uint8_t) gainspan.wireless_channel);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISASSOCIATE_CURRENT_NETWORK:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_GET_CURRENT_NETWORK_STATUS:
 			break;
@@ -1734,117 +2212,124 @@ void gs_send_command(AT_COMMAND at_command){
 			break;
 		case AT_SET_TRANSMISSION_RATE:
 			sprintf(command_buffer,"%s%u\n\r", gs_at_commands[at_command], (uint8_t) gainspan.transmission_rate);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_GET_TRANSMISSION_RATE:
 			break;
 		case AT_SET_AUTHENTICATION_MODE:
 			sprintf(command_buffer,"%s%u\n\r", gs_at_commands[at_command], (uint8_t) gainspan.authentication_mode);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_WIRELESS_SECURITY_CONFIGURATION:
 			sprintf(command_buffer,"%s%u\n\r", gs_at_commands[at_command], (uint8_t) gainspan.wireless_security_configuration);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_WPA_PASSPHRASE:
 			sprintf(command_buffer,"%s%s\n\r", gs_at_commands[at_command], gainspan.security_key);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_WPA2PSK:
 			sprintf(command_buffer,"%s%s,%s\n\r", gs_at_commands[at_command], gainspan.ssid, gainspan.security_key);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISABLE_RADIO:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_ENABLE_RADIO:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISABLE_RADIO_POWER_SAVER_MODE:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_ENABLE_RADIO_POWER_SAVER_MODE:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISABLE_DHCP_IPV4:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_ENABLE_DHCP_IPV4:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_SET_STATIC_NETWORK_PARAMTERS_IPV4:
 			sprintf(command_buffer,"%s%s,%s,%s\n\r", gs_at_commands[at_command], gainspan.local_ip_address, gainspan.subnet, gainspan.gateway);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_STOP_DHCP_SERVER_IPV4:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_START_DHCP_SERVER_IPV4:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_STOP_DNS_SERVER:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_START_DNS_SERVER:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DNS_LOOKUP:
 			break;
 		case AT_STOP_WEBSERVER:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_START_WEBSERVER:
-			sprintf(command_buffer,"%s%s,%s\n\r", gs_at_commands[at_command], gainspan.web_server_administrator_id, gainspan.web_server_administrator_password);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			sprintf(command_buffer,"%s,%s,%s\n\r", gs_at_commands[at_command], gainspan.web_server_administrator_id, gainspan.web_server_administrator_password);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_DISABLE_XML_PARSE:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_ENABLE_XML_PARSE:
 			sprintf(command_buffer,"%s\n\r", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_START_TCP_SERVER:
 			sprintf(command_buffer,"%s%u\n\r", gs_at_commands[at_command], (uint8_t) gainspan.server_port);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_START_TCP_CLIENT:
 			break;
 		case AT_START_UDP_SERVER:
 			break;
 		case AT_START_UDP_CLIENT:
+			sprintf(command_buffer,"%s%s,%u\n\r", gs_at_commands[at_command], gainspan.udp_client_address, (uint16_t) gainspan.udp_client_port);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_CLOSE_CONNECTION_CID:
 			if(gainspan.socket_table[gainspan.active_socket].status != SOCKET_STATUS_CLOSED){
 				sprintf(command_buffer,"%s%x\n\r", gs_at_commands[at_command], gainspan.active_client_cid);
-				usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+				gs_write_to_usart(command_buffer);
 			}
 			break;
 /*
 		case AT_START_WEB_PROVISIONING:
 			sprintf(command_buffer,"%s%s,%s\n", gs_at_commands[at_command], gainspan.web_provision_administrator_id, gainspan.web_provision_administrator_password);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 		case AT_STOP_WEB_PROVISIONING:
 			sprintf(command_buffer,"%s\n", gs_at_commands[at_command]);
-			usart_xfprint(gainspan.usart_id, (uint8_t *) command_buffer);
+			gs_write_to_usart(command_buffer);
 			break;
 */
 		default:
 			break;
 	}
+	/*Start round trip timing, if command is sent*/
+	if (gainspan_statistics.bytes_out != bytes_out_before_command){
+		gainspan.pending_command = at_command;
+		gainspan.command_sent_time = time_in_microseconds();
+	}
 	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
 		/*Send the actual command to serial terminal for debugging*/
 		usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) "\n\r");
@@ -1875,9 +2360,10 @@ uint16_t gs_get_command_response(char *gs_command_response, uint16_t polling_per
 	uint16_t maximum_polling_cycles = polling_period_in_milliseconds / COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS, polling_cycle_counter = 0;
 
 	for(polling_cycle_counter = 0; polling_cycle_counter <= maximum_polling_cycles; polling_cycle_counter++){
-		_delay_ms(COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS);
+		delay_milliseconds(COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS);
 		while (usart_AvailableCharRx(gainspan.usart_id)){
 			usart_xgetChar(gainspan.usart_id, &character_from_response);
+			gs_record_response_received();
 			gs_command_response[string_index] = character_from_response;
 			string_index++;
 			number_of_characters_read++;
@@ -1889,6 +2375,7 @@ uint16_t gs_get_command_response(char *gs_command_response, uint16_t polling_per
 			}
 		 }
 	 }
+	 gs_record_response_timeout();
 
 	 gs_command_response[string_index] = '\0';  //terminate string
 
@@ -1903,6 +2390,58 @@ uint16_t gs_get_command_response(char *gs_command_response, uint16_t polling_per
 }
 
 
+/*!
+ * \brief Collect and parse the scan response from Gainspan WiFi module.
+ *
+ *
+ * \details Collect the response from Gainspan WiFi module for the network scan, line by line, and parse each line
+ * into the scan result as it arrives; hence the response is not limited to CHARACTERS_TO_READ_FROM_GAINSPAN_RESPONSE.
+ * Collection ends on OK or ERROR, or after the polling period.
+ *
+ *
+ * @param scan_result - channel scan result to add the network entries to.
+ * @param polling_period_in_milliseconds - Polling period.
+ * @return - command outcome, valid values are defined by COMMAND_OUTCOME.
+ *
+ */
+COMMAND_OUTCOME gs_get_channel_scan_response(CHANNEL_SCAN_RESULT *scan_result, uint16_t polling_period_in_milliseconds){
+	COMMAND_OUTCOME command_result = COMMAND_OUTCOME_NO_RESPONSE;
+	unsigned char character_from_response = ' ';
+	char scan_line[MAX_TX_BUFFER] = "\0";
+	uint16_t scan_line_index = 0;
+	uint8_t scan_line_truncated = 0;
+	uint16_t maximum_polling_cycles = polling_period_in_milliseconds / COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS, polling_cycle_counter = 0;
+
+	for(polling_cycle_counter = 0; (polling_cycle_counter <= maximum_polling_cycles) && (command_result == COMMAND_OUTCOME_NO_RESPONSE); polling_cycle_counter++){
+		delay_milliseconds(COMMAND_RESPONSE_POLLING_INTERVAL_IN_MILLISECONDS);
+		while (usart_AvailableCharRx(gainspan.usart_id) && (command_result == COMMAND_OUTCOME_NO_RESPONSE)){
+			usart_xgetChar(gainspan.usart_id, &character_from_response);
+			gs_record_response_received();
+			if ((character_from_response == '\r') || (character_from_response == '\n')){				//end of line
+				scan_line[scan_line_index] = '\0';
+				if (scan_line_truncated){
+					/*Only the end of the line is kept, it cannot be OK or ERROR*/
+					gs_parse_channel_scan_line(scan_line, scan_result);
+				} else if (strncmp(scan_line, "OK", 2) == 0){ //OK
+					command_result = COMMAND_OUTCOME_SUCCESS;
+				} else if (strncmp(scan_line, "ERROR", 5) == 0){ //ERROR
+					command_result = COMMAND_OUTCOME_ERROR;
+				} else if (scan_line_index > 0){
+					gs_parse_channel_scan_line(scan_line, scan_result);
+				}
+				scan_line_index = 0;
+				scan_line_truncated = 0;
+			}else {
+				scan_line_truncated |= gs_append_channel_scan_character(scan_line, &scan_line_index, character_from_response);
+			}
+		}
+	}
+	gs_record_response_timeout();
+
+	return command_result;
+}
+
+
 /*!
  * \brief Parse the command response from Gainspan WiFi module.
  *
@@ -1947,6 +2486,10 @@ COMMAND_OUTCOME gs_parse_command_response(char *gs_command_response){
 				string_buffer_index++;
 			}
 		}
+		/*Response without outcome, or outcome ERROR*/
+		if (command_result != COMMAND_OUTCOME_SUCCESS){
+			gainspan_statistics.parse_errors++;
+		}
 	}
 	return command_result;
 }
@@ -2005,6 +2548,7 @@ COMMAND_OUTCOME gs_parse_command_response_tcp(char *gs_command_response, SOCKET_
 										gainspan.active_client_cid = hex_to_int(string_buffer[10]);
 										gainspan.socket_table[socket].cid = hex_to_int(string_buffer[10]);
 										gainspan.socket_table[socket].status = SOCKET_STATUS_ESTABLISHED;
+										gainspan_statistics.accepts++;
 									}
 								}
 							}
@@ -2047,6 +2591,10 @@ COMMAND_OUTCOME gs_parse_command_response_tcp(char *gs_command_response, SOCKET_
 				string_buffer_index++;
 			}
 		}
+		/*Response without outcome, or outcome ERROR; in process mode response may be data*/
+		if ((socket_mode == SOCKET_MODE_ENABLE) && (command_result != COMMAND_OUTCOME_SUCCESS)){
+			gainspan_statistics.parse_errors++;
+		}
 	}
 	return command_result ;
 }
@@ -2120,6 +2668,34 @@ void gs_send_activation_status_to_serial_terminal(GAINSPAN_ACTIVE gs_active){
 
 
 
+/*!
+ * \brief Send the channel scan result and selected channel to serial terminal.
+ *
+ *
+ * \details Sends neighbour count per channel, and the channel selected for the network with its score.
+ *
+ *
+ * @param scan_result - channel scan result.
+ * @param selected_channel - channel selected for the network.
+ *
+ */
+void gs_send_channel_scan_result_to_serial_terminal(CHANNEL_SCAN_RESULT *scan_result, WIRELESS_CHANNEL selected_channel){
+	char string_buffer[80] = "";
+	uint8_t channel = 0;
+
+	sprintf(string_buffer,"\n\rChannel scan: %u networks found; per channel:", scan_result->networks_found);
+	usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) string_buffer);
+	for(channel = WIRELESS_CHANNEL_1; channel <= WIRELESS_CHANNEL_COUNT; channel++){
+		sprintf(string_buffer," %u", scan_result->neighbour_count[channel]);
+		usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) string_buffer);
+	}
+	sprintf(string_buffer,"\n\rChannel scan: channel %u selected, score %lu\n\r", (uint8_t) selected_channel,
+			(unsigned long) gs_get_channel_score(scan_result, selected_channel));
+	usart_xfprint(gainspan.serial_terminal_usart_id, (uint8_t *) string_buffer);
+}
+
+
+
 /*!\brief Initialize web-server.
  *
  * \details Initialize the web-server with default configuration.
@@ -2143,6 +2719,610 @@ void initialize_web_server(uint16_t port, uint8_t protocol){
 }
 
 
+/*!\brief Send web-page.
+ *
+ * \details Sends HTTP header and web-page HTML, with the configured titles and elements.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ *
+ */
+void send_web_page(TCP_SOCKET socket){
+	char html_string[96] = "\0";
+	uint8_t loop_counter = 0;
+
+	//HTML header
+	gs_write_data_to_socket(socket, "HTTP/1.1 200 OK\n");
+	gs_write_data_to_socket(socket, "Content-Type: text/html\n\n");
+	gs_write_data_to_socket(socket, "<!DOCTYPE HTML>\n\n");
+	//Send web page HTML script/code
+	gs_write_data_to_socket(socket, "<html> \n");
+	gs_write_data_to_socket(socket, "<head> \n");
+	/*Page title*/
+	strcpy(html_string, "<title>");
+	strcat(html_string, client_web_page.page_title);
+	strcat(html_string, "</title> \n");
+	gs_write_data_to_socket(socket, html_string);
+	gs_write_data_to_socket(socket, "</head> \n");
+	gs_write_data_to_socket(socket, "<body> \n");
+	/*Page title*/
+	strcpy(html_string, "<center><h1>");
+	strcat(html_string, client_web_page.page_title);
+	strcat(html_string, "</h1> \n");
+	gs_write_data_to_socket(socket, html_string);
+	strcpy(html_string, "<center><h3>");
+	strcat(html_string, client_web_page.menu_title);
+	strcat(html_string, "</h3> \n\n");
+	gs_write_data_to_socket(socket, html_string);
+	/*Send choice to /cmd without reloading the page; without script, form submission reloads the page*/
+	gs_write_data_to_socket(socket, "<script>function c(f){var v=new FormData(f).entries().next().value; \n");
+	gs_write_data_to_socket(socket, "if(v)fetch(\"/cmd?c=\"+v[1]).then(function(r){return r.text();}) \n");
+	gs_write_data_to_socket(socket, ".then(function(t){document.getElementById(\"a\").innerHTML=t;}); \n");
+	gs_write_data_to_socket(socket, "return false;}</script> \n");
+	gs_write_data_to_socket(socket, "<p> \n");
+	gs_write_data_to_socket(socket, "<form method=\"get\" action=\"\" onsubmit=\"return c(this)\"> \n");
+	/*Check for element type*/
+	if (client_web_page.element_type == HTML_DROPDOWN_LIST ){
+		gs_write_data_to_socket(socket, "<select name=\"l\"> \n");
+		/*Add the elements*/
+		for (loop_counter = 0; loop_counter < client_web_page.element_count; loop_counter++){
+			strcpy(html_string, "<option value=\"");
+			strncat(html_string, &client_web_page.web_page_elements[loop_counter].element_identifier, 1);
+			strcat(html_string, "\">");
+			strcat(html_string, client_web_page.web_page_elements[loop_counter].element_label);
+			strcat(html_string, "</option> \n");
+			gs_write_data_to_socket(socket, html_string);
+		}
+		gs_write_data_to_socket(socket, "</select> \n");
+	}else if (client_web_page.element_type == HTML_RADIO_BUTTON){
+		for (loop_counter = 0; loop_counter < client_web_page.element_count; loop_counter++){
+			strcpy(html_string, "<input type=\"radio\" name=\"choice\" value=\"");
+			strncat(html_string, &client_web_page.web_page_elements[loop_counter].element_identifier, 1);
+			strcat(html_string, "\">");
+			strcat(html_string, client_web_page.web_page_elements[loop_counter].element_label);
+			strcat(html_string, " \n");
+			gs_write_data_to_socket(socket, html_string);
+		}
+	}else{
+		gs_write_data_to_socket(socket, "<center><h3> No valid elements added, please check! </h3> \n\n");
+	}
+	gs_write_data_to_socket(socket, "<input type=\"submit\" value=\"Set\"> \n");
+	gs_write_data_to_socket(socket, "</form> \n");
+	gs_write_data_to_socket(socket, "</p> \n");
+	gs_write_data_to_socket(socket, "<p id=\"a\"></p> \n");
+	gs_write_data_to_socket(socket, "</center> \n");
+	gs_write_data_to_socket(socket, "</body> \n");
+	gs_write_data_to_socket(socket, "</html>");
+	gs_write_data_to_socket(socket, "");
+	gs_write_data_to_socket(socket, " ");
+//			gs_write_data_to_socket(socket, "HTTP/1.1 205 Reset Content\n");
+}
+
+
+/*!\brief Find web server route for a request.
+ *
+ * \details Finds the route matching the request path; path matches if it is the route path followed by end of
+ * path (space), or query ('?').
+ *
+ * @param request_path - request path i.e. characters following "GET " in request; query is terminated in place
+ * @param query - pointer, set to characters after '?' up to end of path, if request has query
+ * @return - function serving the route, NULL if no route matches.
+ *
+ */
+WEB_ROUTE_HANDLER find_web_route(char *request_path, char **query){
+	uint8_t loop_counter = 0;
+	size_t route_path_length = 0;
+	char *query_end = NULL;
+
+	for (loop_counter = 0; loop_counter < web_route_count; loop_counter++){
+		route_path_length = strlen(web_routes[loop_counter].route_path);
+		if (strncmp(request_path, web_routes[loop_counter].route_path, route_path_length) == 0){
+			if (request_path[route_path_length] == '?'){
+				*query = &request_path[route_path_length + 1];
+				/*Terminate query at end of path, removes HTTP version*/
+				query_end = strchr(*query, ' ');
+				if (query_end != NULL){
+					*query_end = '\0';
+				}
+				return web_routes[loop_counter].route_handler;
+			}else if ((request_path[route_path_length] == ' ') || (request_path[route_path_length] == '\0')){
+				return web_routes[loop_counter].route_handler;
+			}
+		}
+	}
+	return NULL;
+}
+
+
+/*!\brief Process request path.
+ *
+ * \details Stores the client response of a web-page submission i.e. "/?l=X", in ring buffer; otherwise finds the
+ * route for the path. Web-page is sent only for "/" and submissions, as it is the longest response.
+ *
+ * @param request_path - request path i.e. characters following "GET " in request
+ * @param query - pointer, set to characters after '?' if request has query
+ * @return - function serving the route, NULL for web-page and web-page submission; serve_service_unavailable
+ * if ring buffer is full, serve_not_found if no route matches.
+ *
+ */
+WEB_ROUTE_HANDLER process_request_path(char *request_path, char **query){
+	char *parameter_value = NULL;
+	WEB_ROUTE_HANDLER route_handler = NULL;
+
+	if ((request_path[0] == '?') || ((request_path[0] == '/') && (request_path[1] == '?'))){
+		/*Web-page submission, single character value of element*/
+		parameter_value = strchr(request_path, '=');
+		if (parameter_value != NULL){
+			if (queue_client_response(*(parameter_value + 1)) == ERROR){
+				return serve_service_unavailable;
+			}
+		}
+		return NULL;
+	}
+	if ((request_path[0] == ' ') || (request_path[0] == '\0')
+			|| ((request_path[0] == '/') && ((request_path[1] == ' ') || (request_path[1] == '\0')))){
+		/*Web-page*/
+		return NULL;
+	}
+	route_handler = find_web_route(request_path, query);
+	if (route_handler == NULL){
+		return serve_not_found;
+	}
+	return route_handler;
+}
+
+
+/*!\brief Add client response to ring buffer.
+ *
+ * \details Adds client response to ring buffer for processing, refer get_next_client_response(). Responses not
+ * yet read are never overwritten; read positions are blank.
+ *
+ * @param client_response - single character response according to choice of client on web-page.
+ * @return - outcome, SUCCESS; or ERROR if ring buffer is full.
+ *
+ */
+SUCCESS_ERROR queue_client_response(char client_response){
+	if (client_response_buffer[client_response_buffer_write_pointer] != ' '){
+		return ERROR;
+	}
+	/*Add to circular buffer for processing*/
+	client_response_buffer[client_response_buffer_write_pointer] = client_response;
+	client_response_buffer_write_pointer++;
+	if (client_response_buffer_write_pointer >= RING_BUFFER_SIZE){
+		client_response_buffer_write_pointer = 0;
+	}
+	return SUCCESS;
+}
+
+
+/*!\brief Admit a request within web server budget.
+ *
+ * \details Starts a new budget window if the current one has elapsed, and checks the requests, bytes received, bytes
+ * sent and serve time of the window against the budget.
+ *
+ * @return - SUCCESS if request can be served; ERROR if budget is exhausted.
+ *
+ */
+SUCCESS_ERROR web_server_admit_request(void){
+	unsigned long current_time = time_in_milliseconds();
+
+	if ((current_time - web_server_budget.window_start_time) >= WEB_SERVER_BUDGET_WINDOW_IN_MILLISECONDS){
+		web_server_budget.window_start_time = current_time;
+		web_server_budget.window_start_bytes_in = gainspan_statistics.bytes_in;
+		web_server_budget.window_start_bytes_out = gainspan_statistics.bytes_out;
+		web_server_budget.serve_time = 0;
+		web_server_budget.requests = 0;
+	}
+	if ((web_server_budget.requests >= WEB_SERVER_BUDGET_REQUESTS)
+			|| ((gainspan_statistics.bytes_in - web_server_budget.window_start_bytes_in) >= WEB_SERVER_BUDGET_BYTES_IN)
+			|| ((gainspan_statistics.bytes_out - web_server_budget.window_start_bytes_out) >= WEB_SERVER_BUDGET_BYTES_OUT)
+			|| ((web_server_budget.serve_time / 1000) >= WEB_SERVER_BUDGET_SERVE_TIME_IN_MILLISECONDS)){
+		return ERROR;
+	}
+	return SUCCESS;
+}
+
+
+/*!\brief Charge a served request to web server budget.
+ *
+ * \details Adds the request and its serve time to the budget window; bytes received and sent are taken from driver
+ * statistics.
+ *
+ * @param serve_time - time serving the request, in microseconds.
+ *
+ */
+void web_server_charge_request(unsigned long serve_time){
+	web_server_budget.requests++;
+	web_server_budget.serve_time += serve_time;
+}
+
+
+/*!\brief Serve "503 Service Unavailable".
+ *
+ * \details Route handler for requests rejected by admission control; a single short write to keep it fast.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param query - not used.
+ *
+ */
+void serve_service_unavailable(TCP_SOCKET socket, char *query){
+	gainspan_statistics.requests_rejected++;
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		send_http_response_data(socket, "<busy/>");
+	#else
+		send_http_response_header(socket, "503 Service Unavailable", NULL);
+	#endif
+}
+
+
+/*!\brief Serve "404 Not Found".
+ *
+ * \details Route handler for paths that are neither the web-page nor a route, example "/favicon.ico" requested by
+ * browsers; a single short write instead of the web-page.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param query - not used.
+ *
+ */
+void serve_not_found(TCP_SOCKET socket, char *query){
+	#if SET_WEB_SERVER_MODULE_BACKEND_ON == 1
+		send_http_response_data(socket, "<error/>");
+	#else
+		send_http_response_header(socket, "404 Not Found", NULL);
+	#endif
+}
+
+
+/*!\brief Serve a command.
+ *
+ * \details Route handler for "/cmd?c=X", stores the client response X in ring buffer like a web-page submission, and
+ * acknowledges with the command identifier, example {"id":12}, in a single write; the web-page is not sent.
+ * Answers "400 Bad Request" if X is not an element choice, "503 Service Unavailable" if ring buffer is full.
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param query - "c=" followed by element choice identifier.
+ *
+ */
+void serve_command(TCP_SOCKET socket, char *query){
+	char reply_string[16] = "\0";
+	uint8_t loop_counter = 0;
+
+	if ((query[0] == 'c') && (query[1] == '=')){
+		for (loop_counter = 0; loop_counter < client_web_page.element_count; loop_counter++){
+			if (query[2] == client_web_page.web_page_elements[loop_counter].element_identifier){
+				break;
+			}
+		}
+	}else{
+		loop_counter = client_web_page.element_count;
+	}
+	if (loop_counter >= client_web_page.element_count){
+		send_http_response(socket, "400 Bad Request", NULL, "");
+	}else if (queue_client_response(query[2]) == ERROR){
+		serve_service_unavailable(socket, query);
+	}else{
+		client_command_id++;
+		sprintf(reply_string, "{\"id\":%u}", client_command_id);
+		send_http_response(socket, "200 OK", "application/json", reply_string);
+	}
+}
+
+
+/*!\brief Serve driver statistics.
+ *
+ * \details Route handler for "/stats", sends driver statistics report as plain text, refer gs_format_statistics().
+ *
+ * @param socket - valid socket number, limited by MAX_SOCKET_NUMBER.
+ * @param query - not used.
+ *
+ */
+void serve_statistics_page(TCP_SOCKET socket, char *query){
+	char string_buffer[MAX_TX_BUFFER] = "\0";
+	uint8_t line_number = 0;
+
+	send_http_response_header(socket, "200 OK", "text/plain");
+	for(line_number = 0; gs_format_statistics(string_buffer, line_number) == 1; line_number++){
+		strcat(string_buffer, "\n");
+		send_http_response_data(socket, string_buffer);
+	}
+}
+
+
+/*!
+ * \brief Start the on-module web server.
+ *
+ *
+ * \details Enables XML parser on HTTP data, and starts the Gainspan on-module web server with the administrator
+ * ID and password; requests to WEB_SERVER_MODULE_URI are then forwarded to the MCU.
+ *
+ *
+ * @return - outcome, SUCCESS or ERROR; defined by SUCCESS_ERROR.
+ *
+ */
+SUCCESS_ERROR gs_start_module_web_server(void){
+	char gs_command_response[MAX_TX_BUFFER] = "\0";
+	COMMAND_OUTCOME command_result = COMMAND_OUTCOME_SUCCESS;
+
+	/*Parse HTTP data, forward parameters*/
+	strcpy(gs_command_response, "\0");
+	gs_send_command(AT_ENABLE_XML_PARSE);
+	gs_get_command_response(gs_command_response, 300);
+	command_result = gs_parse_command_response(gs_command_response);
+	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+		gs_send_command_response_to_serial_terminal(AT_ENABLE_XML_PARSE, command_result);
+	#endif
+	if(command_result != COMMAND_OUTCOME_SUCCESS){
+		return ERROR;
+	}
+
+	/*Start web server*/
+	strcpy(gs_command_response, "\0");
+	gs_send_command(AT_START_WEBSERVER);
+	gs_get_command_response(gs_command_response, 300);
+	command_result = gs_parse_command_response(gs_command_response);
+	#if SET_GAINSPAN_TERMINAL_OUTPUT_ON == 1
+		gs_send_command_response_to_serial_terminal(AT_START_WEBSERVER, command_result);
+	#endif
+	if(command_result != COMMAND_OUTCOME_SUCCESS){
+		return ERROR;
+	}
+	return SUCCESS;
+}
+
+
+/*!
+ * \brief Process client requests forwarded by on-module web server.
+ *
+ *
+ * \details Reads the frames forwarded by on-module web server, and for each request to WEB_SERVER_MODULE_URI:
+ * 	- stores the client response of a web-page submission, "?l=X" or XML element "<l>X</l>", in ring buffer,
+ * 	  and replies the accepted value as "<l>X</l>"
+ * 	- or serves the route following WEB_SERVER_MODULE_URI, example WEB_SERVER_MODULE_URI"/stats"
+ * 	- or replies "<error/>"
+ *
+ *
+ */
+void process_module_client_request(void){
+	char data_string[CHARACTERS_TO_READ_FROM_GAINSPAN_RESPONSE + 1] = "\0";
+	char reply_string[12] = "\0";
+	uint16_t data_length = 0;
+	uint16_t data_index = 0;
+	uint16_t payload_length = 0;
+	uint8_t cid = INVALID_CID;
+	char *payload = NULL;
+	char *request_path = NULL;
+	char *query = "";
+	char *element_value = NULL;
+	char next_frame_character = '\0';
+	WEB_ROUTE_HANDLER route_handler = NULL;
+	uint8_t client_response_buffer_write_pointer_before_request = 0;
+	unsigned long page_serve_start_time = 0;
+	unsigned long page_serve_time = 0;
+
+	if (web_server_status != WEB_SERVER_ACTIVE){
+		return;
+	}
+
+	data_length = gs_get_command_response(data_string, 300);
+
+	while (data_index < data_length){
+		payload_length = gs_parse_module_web_server_frame(&data_string[data_index], data_length - data_index, &cid, &payload);
+		if (payload == NULL){
+			/*Not a frame, skip the character*/
+			data_index++;
+			continue;
+		}
+		data_index = (payload - data_string) + payload_length;
+		page_serve_start_time = time_in_microseconds();
+		gainspan.active_client_cid = cid;
+		gainspan_statistics.frames_parsed++;
+
+		/*Terminate payload; first character of next frame is restored after the request is served*/
+		next_frame_character = payload[payload_length];
+		payload[payload_length] = '\0';
+		route_handler = NULL;
+		query = "";
+		client_response_buffer_write_pointer_before_request = client_response_buffer_write_pointer;
+		request_path = strstr(payload, WEB_SERVER_MODULE_URI);
+		if (web_server_admit_request() == ERROR){
+			route_handler = serve_service_unavailable;
+		}else if (request_path != NULL){
+			request_path += strlen(WEB_SERVER_MODULE_URI);
+			element_value = strstr(request_path, "<l>");
+			if (element_value != NULL){
+				/*XML element of web-page submission*/
+				if (queue_client_response(*(element_value + 3)) == ERROR){
+					route_handler = serve_service_unavailable;
+				}
+			}else{
+				route_handler = process_request_path(request_path, &query);
+			}
+		}
+
+		if (route_handler != NULL){
+			route_handler(wifi_client.client_socket, query);
+		}else if (client_response_buffer_write_pointer != client_response_buffer_write_pointer_before_request){
+			sprintf(reply_string, "<l>%c</l>", client_response_buffer[client_response_buffer_write_pointer_before_request]);
+			gs_write_module_web_server_frame(cid, reply_string);
+		}else{
+			gainspan_statistics.parse_errors++;
+			gs_write_module_web_server_frame(cid, "<error/>");
+		}
+
+		payload[payload_length] = next_frame_character;
+
+		page_serve_time = time_in_microseconds() - page_serve_start_time;
+		gainspan_statistics.pages_served++;
+		gs_record_time_in_histogram(gainspan_statistics.page_serve_time_histogram, page_serve_time_bucket_limits, page_serve_time);
+		if (route_handler != serve_service_unavailable){
+			web_server_charge_request(page_serve_time);
+		}
+	}
+}
+
+
+/*!
+ * \brief Parse a frame forwarded by on-module web server.
+ *
+ *
+ * \details Parses the frame header, Escape 'K' CID and 4 digit data length, followed by data. For more details
+ * read the Serial-to-WiFi adapter guide for XML parser on HTTP data.
+ *
+ *
+ * @param frame_string - characters received, starting at the frame.
+ * @param frame_length - number of characters received, starting at the frame.
+ * @param cid - pointer, set to client CID of the frame.
+ * @param payload - pointer, set to the data of the frame; NULL if characters are not a frame.
+ * @return - data length; limited to the characters received.
+ *
+ */
+uint16_t gs_parse_module_web_server_frame(char *frame_string, uint16_t frame_length, uint8_t *cid, char **payload){
+	uint16_t data_length = 0;
+	uint8_t digit_index = 0;
+
+	*payload = NULL;
+	if ((frame_length < WEB_SERVER_MODULE_FRAME_HEADER_SIZE) || (frame_string[0] != '\x1b') || (frame_string[1] != 'K')){
+		return 0;
+	}
+	for (digit_index = 3; digit_index < WEB_SERVER_MODULE_FRAME_HEADER_SIZE; digit_index++){
+		if ((frame_string[digit_index] < '0') || (frame_string[digit_index] > '9')){
+			return 0;
+		}
+		data_length = (data_length * 10) + (frame_string[digit_index] - '0');
+	}
+	*cid = hex_to_int(frame_string[2]);
+	*payload = &frame_string[WEB_SERVER_MODULE_FRAME_HEADER_SIZE];
+	/*Rest of data beyond the characters received is discarded*/
+	if (data_length > (frame_length - WEB_SERVER_MODULE_FRAME_HEADER_SIZE)){
+		data_length = frame_length - WEB_SERVER_MODULE_FRAME_HEADER_SIZE;
+	}
+	return data_length;
+}
+
+
+/*!
+ * \brief Write a response frame to on-module web server.
+ *
+ *
+ * \details Writes Escape 'K' CID, 4 digit data length, and data; on-module web server adds HTTP framing and sends
+ * the data to the client.
+ *
+ *
+ * @param cid - client CID of the request.
+ * @param data_string - data to be written. Limited by MAX_TX_BUFFER
+ *
+ */
+void gs_write_module_web_server_frame(uint8_t cid, char *data_string){
+	char command_buffer[MAX_TX_BUFFER];
+
+	/*Escape sequence, 'K', CID and data length*/
+	sprintf(command_buffer, "\x1bK%x%04u", cid, (uint16_t) strlen(data_string));
+	gs_write_to_usart(command_buffer);
+
+	/*Transmit data*/
+	gs_write_to_usart(data_string);
+}
+
+
+/*!
+ * \brief Write string to Gainspan WiFi module.
+ *
+ *
+ * \details Writes the string to USART connected to Gainspan WiFi module, and counts the bytes sent.
+ *
+ *
+ * @param string_buffer - string to write.
+ *
+ */
+void gs_write_to_usart(char *string_buffer){
+	gainspan_statistics.bytes_out += strlen(string_buffer);
+	usart_xfprint(gainspan.usart_id, (uint8_t *) string_buffer);
+}
+
+
+/*!
+ * \brief Record a character received from Gainspan WiFi module.
+ *
+ *
+ * \details Counts the byte received; first character after a command completes the command round trip.
+ *
+ *
+ */
+void gs_record_response_received(void){
+	gainspan_statistics.bytes_in++;
+	if (gainspan.pending_command != AT_COMMAND_INVALID){
+		gs_record_time_in_histogram(gainspan_statistics.command_round_trip_time_histogram, command_round_trip_time_bucket_limits, time_in_microseconds() - gainspan.command_sent_time);
+		gainspan.pending_command = AT_COMMAND_INVALID;
+	}
+}
+
+
+/*!
+ * \brief Record end of response collection from Gainspan WiFi module.
+ *
+ *
+ * \details Counts a timeout for the pending command, if no character of response has been received.
+ *
+ *
+ */
+void gs_record_response_timeout(void){
+	if ((gainspan.pending_command != AT_COMMAND_INVALID) && (gainspan.pending_command < AT_COMMAND_COUNT)){
+		if (gainspan_statistics.command_timeouts[gainspan.pending_command] < UINT16_MAX){
+			gainspan_statistics.command_timeouts[gainspan.pending_command]++;
+		}
+	}
+	gainspan.pending_command = AT_COMMAND_INVALID;
+}
+
+
+/*!
+ * \brief Record time in histogram.
+ *
+ *
+ * \details Increments the bucket of the histogram for the elapsed time; saturates at UINT16_MAX.
+ *
+ *
+ * @param histogram - histogram with STATISTICS_HISTOGRAM_BUCKETS buckets.
+ * @param bucket_limits - upper limits of the buckets in milliseconds, except the last bucket.
+ * @param elapsed_microseconds - time to record.
+ *
+ */
+void gs_record_time_in_histogram(uint16_t *histogram, const uint16_t *bucket_limits, unsigned long elapsed_microseconds){
+	uint8_t bucket = 0;
+	unsigned long elapsed_milliseconds = elapsed_microseconds / 1000;
+
+	while ((bucket < (STATISTICS_HISTOGRAM_BUCKETS - 1)) && (elapsed_milliseconds > bucket_limits[bucket])){
+		bucket++;
+	}
+	if (histogram[bucket] < UINT16_MAX){
+		histogram[bucket]++;
+	}
+}
+
+
+/*!
+ * \brief Format histogram.
+ *
+ *
+ * \details Formats histogram as title followed by <=limit:count for each bucket, and >limit:count for the last.
+ *
+ *
+ * @param string_buffer - string buffer to return the histogram, minimum MAX_TX_BUFFER characters.
+ * @param histogram_title - title.
+ * @param histogram - histogram with STATISTICS_HISTOGRAM_BUCKETS buckets.
+ * @param bucket_limits - upper limits of the buckets in milliseconds, except the last bucket.
+ *
+ */
+void gs_format_histogram(char *string_buffer, char *histogram_title, uint16_t *histogram, const uint16_t *bucket_limits){
+	uint8_t bucket = 0;
+
+	strcpy(string_buffer, histogram_title);
+	for (bucket = 0; bucket < (STATISTICS_HISTOGRAM_BUCKETS - 1); bucket++){
+		sprintf(string_buffer + strlen(string_buffer), " <=%u:%u", bucket_limits[bucket], histogram[bucket]);
+	}
+	sprintf(string_buffer + strlen(string_buffer), " >%u:%u", bucket_limits[STATISTICS_HISTOGRAM_BUCKETS - 2], histogram[STATISTICS_HISTOGRAM_BUCKETS - 1]);
+}
+
+
 /*!
  * \brief Convert Hexadecimal to Integer.
  *